@@ -89,6 +89,48 @@ _Bool AssocDictAdd(struct AssocDict* d, const void* key, const void* val)
 	return true;
 }
 
+void AssocDictRemove(struct AssocDict* d, const void* key)
+{
+	assert(d); // STRICT
+	assert(key);
+	if (!d) return;
+
+	const size_t pairsize = d->keysize + d->valsize;
+	for (unsigned long i = 0; i < d->n; ++i) {
+		char* curr_key = d->dictBuf + i * pairsize;
+		if (d->keyEq(curr_key, key)) {
+			if (d->keyfree) d->keyfree(curr_key);
+			if (d->valfree) d->valfree(curr_key + d->keysize);
+			// Close the gap, keeping the remaining pairs in order.
+			memmove(curr_key, curr_key + pairsize, (d->n - i - 1) * pairsize);
+			--d->n;
+			return;
+	}}
+}
+
+_Bool AssocDictReplace(struct AssocDict* d, const void* key, const void* val)
+{
+	assert(d); // STRICT
+	assert(key);
+	assert(val);
+	if (!d) return false;
+
+	const size_t pairsize = d->keysize + d->valsize;
+	for (unsigned long i = 0; i < d->n; ++i) {
+		char* curr_key = d->dictBuf + i * pairsize;
+		if (d->keyEq(curr_key, key)) {
+			if (d->keyfree) d->keyfree(curr_key);
+			if (d->valfree) d->valfree(curr_key + d->keysize);
+			// As Remove then Add: the pair moves to the end.
+			memmove(curr_key, curr_key + pairsize, (d->n - i - 1) * pairsize);
+			char* last = d->dictBuf + (d->n - 1) * pairsize;
+			memcpy(last, key, d->keysize);
+			memcpy(last + d->keysize, val, d->valsize);
+			return true;
+	}}
+	return AssocDictAdd(d, key, val);
+}
+
 _Bool AssocDictHas(const struct AssocDict* d, const void* key)
 {
 	assert(d); // STRICT
@@ -116,6 +158,20 @@ _Bool AssocDictGet(const struct AssocDict* d, const void* key,
 	return false;
 }
 
+void AssocDictEach(const struct AssocDict* d,
+	               void (*visit)(const void* key, const void* val, void* ctx),
+	               void* ctx)
+{
+	assert(d); // STRICT
+	assert(visit);
+	if (!d) return;
+
+	for (unsigned long i = 0; i < d->n; ++i) {
+		char* curr_key = d->dictBuf + i * (d->keysize + d->valsize);
+		visit(curr_key, curr_key + d->keysize, ctx);
+	}
+}
+
 void AssocDictDelete(AssocDict d)
 {
 	assert(d); // STRICT
@@ -125,7 +181,7 @@ void AssocDictDelete(AssocDict d)
 	for (unsigned i = 0; i < d->n; ++i) {
 		char* curr_key = d->dictBuf + i * (d->keysize + d->valsize);
 		if (d->keyfree) d->keyfree(curr_key);
-		if (d->valfree) d->valfree(curr_key + d->valsize);
+		if (d->valfree) d->valfree(curr_key + d->keysize);
 	}
 dd_free:
 	free(d->dictBuf);
@@ -18,12 +18,22 @@ AssocDict AssocDictNew(void* memory, size_t keysize, size_t valsize,
 
 _Bool AssocDictAdd(struct AssocDict* d, const void* key, const void* val);
 
+void AssocDictRemove(struct AssocDict* d, const void* key);
+
+/* As Remove then Add, without reallocating when `key` is present. */
+_Bool AssocDictReplace(struct AssocDict* d, const void* key, const void* val);
+
 _Bool AssocDictHas(const struct AssocDict* d, const void* key);
 
 _Bool AssocDictGet(const struct AssocDict* d, const void* key,
 	               // valSpace can be NULL
 	               void* valSpace);
 
+/* Calls `visit` on every pair, in the order they were added. */
+void AssocDictEach(const struct AssocDict* d,
+	               void (*visit)(const void* key, const void* val, void* ctx),
+	               void* ctx);
+
 void AssocDictDelete(struct AssocDict* d);
 
 #ifdef ASSOCDICT_PREFIX
@@ -40,11 +50,19 @@ static AssocDict (* const ASSOCDICT_METHOD(New))(
 static _Bool (* const ASSOCDICT_METHOD(Add))(struct AssocDict* d,
 	            const void* key,
 	            const void* val) = AssocDictAdd;
+static void  (* const ASSOCDICT_METHOD(Remove))(struct AssocDict* d,
+	            const void* key) = AssocDictRemove;
+static _Bool (* const ASSOCDICT_METHOD(Replace))(struct AssocDict* d,
+	            const void* key,
+	            const void* val) = AssocDictReplace;
 static _Bool (* const ASSOCDICT_METHOD(Has))(const struct AssocDict* d,
 	            const void* key) = AssocDictHas;
 static _Bool (* const ASSOCDICT_METHOD(Get))(const struct AssocDict* d,
 	            const void* key,
 	            void* valSpace) = AssocDictGet;
+static void  (* const ASSOCDICT_METHOD(Each))(const struct AssocDict* d,
+	            void (*visit)(const void* key, const void* val, void* ctx),
+	            void* ctx) = AssocDictEach;
 static void  (* const ASSOCDICT_METHOD(Delete))(
 	           struct AssocDict* d) = AssocDictDelete;
 
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h> // malloc, free
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "Batch.h"
+#include "Alloca.h"
+#include "Assert.h"
+#include "CleanLeaks.h"
+#include "ForthTypes.h"
+#include "Image.h"
+#include "Session.h"
+
+struct job {
+	const char* path;
+	char*  output; /* What the script printed, once it is done. */
+	size_t size;
+	_Bool  ok;
+	_Bool  done;   /* Guarded by the batch's lock. */
+};
+
+/* A worker's share of the jobs, those from `front` up to `back`. Its worker
+   takes them from the front, and other workers steal them from the back. */
+struct share {
+	pthread_mutex_t lock;
+	size_t front, back;
+};
+
+struct batch {
+	Snapshot    snap;
+	RunScriptFN run;
+	struct job*   jobs;
+	struct share* shares;
+	unsigned      nWorkers;
+
+	pthread_mutex_t lock;
+	pthread_cond_t  finished; /* Signalled whenever a job is done. */
+};
+
+struct worker {
+	struct batch* batch;
+	unsigned id;
+};
+
+/* Takes the index of a job from the front of `s`, or its back if `steal`. */
+/* Returns false if `s` has none left. */
+static _Bool Take(struct share* s, _Bool steal, size_t* job)
+{
+	pthread_mutex_lock(&s->lock);
+	const _Bool any = s->front < s->back;
+	if (any) *job = steal ? --s->back : s->front++;
+	pthread_mutex_unlock(&s->lock);
+	return any;
+}
+
+static void RunJob(struct batch* b, struct job* job)
+{
+	FILE* out = open_memstream(&job->output, &job->size);
+	if (!out) {
+		fprintf(stderr, "FAIL: Out of memory running `%s`.\n", job->path);
+		return; }
+
+	struct ImageMap map = {0};
+	Session s; PALLOCA(s, SessionSize());
+	if ((s = SessionNew(s, b->snap, out, stderr))) {
+		const struct State state = SessionState(s);
+		job->ok = b->run(state, job->path, &map);
+		if (state.types)
+			CleanLeaks(state.stack, state.types, stderr);
+		SessionDelete(s);
+	} else fprintf(stderr, "FAIL: Could not start a session for `%s`.\n",
+	               job->path);
+	/* Only once the session is gone does nothing refer to the image. */
+	ImageClose(&map);
+	fclose(out);
+}
+
+/* Takes the next job for worker `id`: one of its own, or else one stolen
+   from another worker. Returns false once there are none left. */
+static _Bool Next(struct batch* b, unsigned id, size_t* j)
+{
+	if (Take(&b->shares[id], false, j)) return true;
+	for (unsigned i = 1; i < b->nWorkers; ++i)
+		if (Take(&b->shares[(id + i) % b->nWorkers], true, j)) return true;
+	/* No job is ever added, so once all shares are empty, they stay so. */
+	return false;
+}
+
+static void* Work(void* vw)
+{
+	const struct worker* w = vw;
+	struct batch* b = w->batch;
+	size_t j = 0;
+	while (Next(b, w->id, &j)) {
+		RunJob(b, &b->jobs[j]);
+
+		pthread_mutex_lock(&b->lock);
+		b->jobs[j].done = true;
+		pthread_cond_broadcast(&b->finished);
+		pthread_mutex_unlock(&b->lock); }
+	return NULL;
+}
+
+/********** PUBLIC **********/
+_Bool RunBatch(Snapshot snap, const char* const* paths, size_t n,
+               unsigned workers, RunScriptFN run, FILE* out)
+{
+	cassert(snap);
+	cassert(paths || !n);
+	cassert(run);
+	cassert(out);
+	if (!workers) workers = 1;
+	if (workers > n) workers = n ? n : 1;
+
+	struct batch b = {snap, run, NULL, NULL, workers,
+	                  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+	struct worker* pool = malloc(workers * sizeof(*pool));
+	pthread_t*  threads = malloc(workers * sizeof(*threads));
+	b.jobs   = calloc(n + 1, sizeof(*b.jobs));
+	b.shares = malloc(workers * sizeof(*b.shares));
+	if (!pool || !threads || !b.jobs || !b.shares) {
+		free(pool);
+		free(threads);
+		free(b.jobs);
+		free(b.shares);
+		fprintf(stderr, "FAIL: Out of memory starting a batch.\n");
+		return false; }
+
+	for (size_t i = 0; i < n; ++i)
+		b.jobs[i].path = paths[i];
+	/* Each worker starts with a run of neighbouring jobs, so that the first
+	   jobs, which are output first, are also run first. */
+	for (unsigned w = 0; w < workers; ++w) {
+		pthread_mutex_init(&b.shares[w].lock, NULL);
+		b.shares[w].front = n * w / workers;
+		b.shares[w].back  = n * (w + 1) / workers;
+		pool[w] = (struct worker){&b, w}; }
+
+	unsigned started = 0;
+	while (started < workers &&
+	       !pthread_create(&threads[started], NULL, Work, &pool[started]))
+		++started;
+	/* Without a single thread, the work is done here; others are stolen. */
+	if (!started) Work(&pool[0]);
+
+	_Bool ok = true;
+	for (size_t i = 0; i < n; ++i) {
+		pthread_mutex_lock(&b.lock);
+		while (!b.jobs[i].done)
+			pthread_cond_wait(&b.finished, &b.lock);
+		pthread_mutex_unlock(&b.lock);
+		if (b.jobs[i].output)
+			fwrite(b.jobs[i].output, 1, b.jobs[i].size, out);
+		fflush(out);
+		free(b.jobs[i].output);
+		ok &= b.jobs[i].ok; }
+
+	for (unsigned w = 0; w < started; ++w)
+		pthread_join(threads[w], NULL);
+	for (unsigned w = 0; w < workers; ++w)
+		pthread_mutex_destroy(&b.shares[w].lock);
+	pthread_mutex_destroy(&b.lock);
+	pthread_cond_destroy(&b.finished);
+	free(pool);
+	free(threads);
+	free(b.jobs);
+	free(b.shares);
+	return ok;
+}
@@ -0,0 +1,23 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <stddef.h>
+#include <stdio.h>
+#include "ForthTypes.h"
+#include "Session.h"
+#include "Image.h"
+
+/* Runs the script at `path` in `state`, mapping whatever image it brings
+   into `map`. Returns false if the script could not be run. */
+typedef _Bool (*RunScriptFN)(struct State state, const char* path,
+                             struct ImageMap* map);
+
+/* Runs the `n` scripts of `paths` on a pool of `workers` threads, each
+   script with `run`, in a session of its own started from `snap`. */
+/* Workers take scripts from their own share of them first, and then steal
+   from the others' shares. A script's output is written to `out` once it,
+   and every script before it, is done; so it all appears in order. */
+/* Returns false if any script could not be run. */
+_Bool RunBatch(Snapshot snap, const char* const* paths, size_t n,
+               unsigned workers, RunScriptFN run, FILE* out);
+
+#endif /* BATCH_H */
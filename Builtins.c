@@ -1,21 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h> // free
-#include <string.h> // strdup, if available, and strlen & strcpy if not.
+#include <string.h> // memcpy; strdup, if available, and strlen & strcpy if not.
 #include <stdbool.h>
+#include <limits.h> // LONG_MAX
+#include <sched.h>  // sched_yield
 
 #include "Dict.h"
 #include "Stack.h"
+#include "Alloca.h"
 #include "Assert.h"
 #include "ForthTypes.h"
+#include "ForthString.h"
+#include "ForthVector.h"
+#include "DataSpace.h"
 #include "Builtins.h"
+#include "Eval.h"
+#include "Execute.h"
+#include "GetObj.h"
+#include "Image.h"
+#include "Output.h"
+#include "Session.h"
+#include "Task.h"
+#include "Channel.h"
 
 #include "Strdup.h"
 
-/* Private state initialized by ImportBuiltins. */
-static _Bool (*Pop )(struct State s, void* elemSpace) = NULL;
-static _Bool (*Push)(struct State s, enum datum_type type,
-                      const void* datum) = NULL;
-
 /********** PRIVATE: UTILITY FUNCTIONS **********/
 static _Bool PopWithTypeStack(struct State s, void* elemSpace)
 {
@@ -59,23 +68,352 @@ static _Bool PushWithoutTypeStack(struct State s,
 	return StackPush(s.stack, datum);
 }
 
+/* Whether the type stack is kept up is up to each state, so that states
+   with and without one can be used at once. */
+static _Bool Pop(struct State s, void* elemSpace)
+{
+	return s.types ? PopWithTypeStack(s, elemSpace)
+	               : PopWithoutTypeStack(s, elemSpace);
+}
+
+static _Bool Push(struct State s, enum datum_type type, const void* datum)
+{
+	return s.types ? PushWithTypeStack(s, type, datum)
+	               : PushWithoutTypeStack(s, type, datum);
+}
+
+/* Pops an item together with its type, which is T_INT when typing is off. */
+static _Bool PopTyped(struct State s, enum datum_type* type, ForthDatum* d)
+{
+	*type = T_INT;
+	if (s.types && !StackPop(s.types, type))
+		return false;
+	return StackPop(s.stack, d);
+}
+
+/* Pops the top two items, ( second top -- ). */
+static _Bool Pop2(struct State s, ForthDatum* second, ForthDatum* top)
+{
+	return Pop(s, top) && Pop(s, second);
+}
+
+/* The floating-point stack, which a state can be without. Words check
+   that it holds the `n` numbers they take before popping any. */
+static _Bool NeedFloats(struct State s, size_t n)
+{
+	if (s.floats && StackDepth(s.floats) >= n) return true;
+	OutputError(s.output, "ERROR: Floating-point stack underflow.\n");
+	return false;
+}
+
+static _Bool PopFloat(struct State s, double* f)
+{
+	return NeedFloats(s, 1) && StackPop(s.floats, f);
+}
+
+static _Bool PushFloat(struct State s, double f)
+{
+	if (s.floats && StackPush(s.floats, &f)) return true;
+	OutputError(s.output, "ERROR: Floating-point stack overflow.\n");
+	return false;
+}
+
+static _Bool PopFloat2(struct State s, double* second, double* top)
+{
+	return NeedFloats(s, 2) && StackPop(s.floats, top)
+	    && StackPop(s.floats, second);
+}
+
+/* Adds an owner to a shared item; others are copied as they are. */
+static void Retain(enum datum_type t, ForthDatum d)
+{
+	if (T_STRING == t) StringRetain(d);
+	else if (T_VECTOR == t) VectorRetain(d.Vector);
+}
+
+static void Release(enum datum_type t, ForthDatum d)
+{
+	if (T_STRING == t) StringRelease(d);
+	else if (T_VECTOR == t) VectorRelease(d.Vector);
+}
+
+/* Reports that a word found fewer items on the stack than it takes. */
+static void Underflow(struct State s)
+{
+	OutputError(s.output, "ERROR: Stack underflow.\n");
+}
+
+/* Checks that the stack holds the `n` items a word takes, before it pops
+   any of them, reporting it if not. */
+static _Bool Need(struct State s, size_t n)
+{
+	if (StackDepth(s.stack) >= n) return true;
+	Underflow(s);
+	return false;
+}
+
+/* Pops a string, after reporting it if it's missing, or something else.
+   Without a type stack, the item is taken to be one. */
+static _Bool PopString(struct State s, ForthDatum* d)
+{
+	enum datum_type t;
+	if (!PopTyped(s, &t, d)) {
+		Underflow(s);
+		return false; }
+	if (T_STRING == t || !s.types) return true;
+	OutputError(s.output, "ERROR: Expected a string.\n");
+	Release(t, *d);
+	return false;
+}
+
+/* Forth's canonical truth values. */
+#define FLAG(pred) ((pred) ? -1L : 0L)
+
+/* Returns the item `n` places below the top, or NULL if there are fewer. */
+static ForthDatum* Peek(struct State s, size_t n)
+{
+	const size_t depth = StackDepth(s.stack);
+	return n < depth ? (ForthDatum*)StackPeek(s.stack) + depth - 1 - n : NULL;
+}
+
+/* Channels are kept on the stack by handle; see 'Channel.h'. What this
+   returns is to be given to ChannelRelease. */
+static Channel ChannelOf(struct State s, const ForthDatum* d)
+{
+	return ChannelFind(s.channels, d->Int);
+}
+
+/* Called when a channel word can't go on yet. Returns true if the word
+   is to return, and be run again later, or give up, with nothing else
+   running that could ever let it go on, or once `c` has been closed;
+   false if it may try again now. */
+static _Bool Wait(struct State s, const Channel c)
+{
+	if (ChannelClosed(c)) {
+		OutputError(s.output, "ERROR: The channel was freed while in use.\n");
+		return true; }
+	if (!TasksOthers(s.tasks) && !ChannelsShared(s.channels)) {
+		OutputError(s.output, "ERROR: Nothing else runs to use the channel.\n");
+		return true; }
+	if (s.tasks && TasksBlock(s.tasks)) return true;
+	sched_yield(); /* Perhaps for a thread at the other end. */
+	return false;
+}
+
+/* ( x1 .. xn [n] chan -- ) Sends the `count` items below the `argc`
+   arguments on top of the stack, once there is room for all of them. */
+static void Send(struct State s, size_t count, size_t argc)
+{
+	const ForthDatum* chan = Peek(s, 0);
+	const Channel c = chan ? ChannelOf(s, chan) : NULL;
+	if (!c || StackDepth(s.stack) < count + argc ||
+	    count > ChannelCapacity(c)) {
+		OutputError(s.output, "ERROR: Bad arguments to a channel send.\n");
+		goto Send_Release; }
+
+	const size_t base = StackDepth(s.stack) - argc - count;
+	while (!ChannelSend(c, (ForthDatum*)StackPeek(s.stack) + base,
+	                    s.types ? (enum datum_type*)StackPeek(s.types) + base
+	                            : NULL,
+	                    count))
+		if (Wait(s, c)) goto Send_Release;
+
+	/* The channel owns the items now, strings and all. */
+	for (size_t i = 0; i < count + argc; ++i)
+		Pop(s, NULL);
+
+Send_Release:
+	if (c) ChannelRelease(c);
+}
+
+/* ( [n] chan -- x1 .. xn ) Replaces the `argc` arguments on top of the
+   stack by `count` items received, once that many have been sent. */
+static void Receive(struct State s, size_t count, size_t argc)
+{
+	ForthDatum args[2];
+	const ForthDatum* chan = Peek(s, 0);
+	const Channel c = chan ? ChannelOf(s, chan) : NULL;
+	if (!c || StackDepth(s.stack) < argc || count > ChannelCapacity(c)) {
+		OutputError(s.output, "ERROR: Bad arguments to a channel receive.\n");
+		goto Receive_Release; }
+
+	/* Items are received straight into room made for them on the stack. */
+	for (size_t i = 0; i < argc; ++i)
+		Pop(s, &args[i]);
+	const size_t base = StackDepth(s.stack);
+	const ForthDatum zero = {.Int = 0};
+	for (size_t i = 0; i < count; ++i)
+		if (!Push(s, T_INT, &zero)) goto Receive_Restore;
+
+	while (!ChannelReceive(c, (ForthDatum*)StackPeek(s.stack) + base,
+	                       s.types ? (enum datum_type*)StackPeek(s.types) + base
+	                               : NULL,
+	                       count))
+		if (Wait(s, c)) goto Receive_Restore;
+	ChannelRelease(c);
+	return;
+
+	/* ERROR BLOCK */
+Receive_Restore:
+	/* Retried later, or given up on: put the arguments back as they were. */
+	while (StackDepth(s.stack) > base)
+		Pop(s, NULL);
+	for (size_t i = argc; i--; )
+		Push(s, T_INT, &args[i]);
+Receive_Release:
+	if (c) ChannelRelease(c);
+}
+
 /********** PRIVATE: BUILTIN FUNCTIONS **********/
-static void HelloWorld(struct State _ __attribute__((unused)))
+/* ( path -- ) Saves the namespace's definitions, for use with --image. */
+static void SaveImage(struct State s)
+{
+	ForthDatum d;
+	if (!PopString(s, &d)) return;
+	if (s.confined)
+		OutputError(s.output, "ERROR: SAVE-IMAGE isn't allowed here.\n");
+	else if (!ImageSave(StringText(&d), s))
+		OutputError(s.output, "ERROR: Could not save an image to `%s`.\n",
+		            StringText(&d));
+	StringRelease(d);
+}
+
+/* ( [x1 .. xn n] name -- ) Starts the compiled word `name` as a task, or
+   on a thread if `thread`, handing it the n items below if `counted`. */
+static void Start(struct State s, _Bool counted, _Bool thread)
+{
+	ForthDatum d, n = {.Int = 0};
+	enum datum_type t = T_INT;
+	ForthWord fw;
+	if (!PopString(s, &d)) return;
+	if (counted && (!PopTyped(s, &t, &n) || T_INT != t || n.Int < 0)) {
+		Release(t, n);
+		OutputError(s.output, "ERROR: Bad item count for `%s`.\n",
+		            StringText(&d)); }
+	else if (!s.tasks)
+		OutputError(s.output, "ERROR: `%s` can't be started here.\n",
+		            StringText(&d));
+	else if (!Lookup(s, StringText(&d), &fw) || F_COMPILED != fw.type)
+		OutputError(s.output, "ERROR: `%s` isn't a compiled word.\n",
+		            StringText(&d));
+	else if (!(thread ? TaskThread : TaskSpawn)(s.tasks, s, fw.data.compiled,
+	                                            n.Int))
+		OutputError(s.output, "ERROR: Could not start `%s`.\n", StringText(&d));
+	StringRelease(d);
+}
+
+/* ( name -- ) Starts a task running the compiled word `name`. */
+static void Spawn(struct State s)
+{
+	Start(s, false, false);
+}
+
+/* ( x1 .. xn n name -- ) As SPAWN, moving n items onto the task's stack. */
+static void SpawnN(struct State s)
+{
+	Start(s, true, false);
+}
+
+/* ( name -- ) Runs the compiled word `name` on a thread of its own. */
+static void Thread(struct State s)
+{
+	Start(s, false, true);
+}
+
+/* ( x1 .. xn n name -- ) As THREAD, moving n items onto its stack. */
+static void ThreadN(struct State s)
+{
+	Start(s, true, true);
+}
+
+/* ( capacity -- chan ) Makes a channel, from one task or thread to one. */
+static void Chan(struct State s)
+{
+	ForthDatum d;
+	if (!Pop(s, &d)) return; // TODO: ERROR HANDLING
+	const long handle = d.Int > 0 ? ChannelOpen(s.channels, d.Int) : 0;
+	if (!handle) {
+		OutputError(s.output, "ERROR: Could not make a channel of %ld.\n",
+		            d.Int);
+		return; }
+	d.Int = handle;
+	Push(s, T_INT, &d);
+}
+
+/* ( chan -- ) Frees a channel no one uses any more. */
+static void ChanFree(struct State s)
+{
+	ForthDatum d;
+	if (!Pop(s, &d)) return; // TODO: ERROR HANDLING
+	if (!ChannelClose(s.channels, d.Int))
+		OutputError(s.output, "ERROR: %ld isn't a channel.\n", d.Int);
+}
+
+/* ( x chan -- ) Sends an item, waiting for room if the channel is full. */
+static void ToChan(struct State s)
+{
+	Send(s, 1, 1);
+}
+
+/* ( chan -- x ) Receives an item, waiting for one if there are none. */
+static void FromChan(struct State s)
+{
+	Receive(s, 1, 1);
+}
+
+/* ( x1 .. xn n chan -- ) Sends n items at once. */
+static void ToChanN(struct State s)
+{
+	const ForthDatum* n = Peek(s, 1);
+	if (!n || n->Int < 0) return; // TODO: ERROR HANDLING
+	Send(s, n->Int, 2);
+}
+
+/* ( n chan -- x1 .. xn ) Receives n items at once. */
+static void FromChanN(struct State s)
+{
+	const ForthDatum* n = Peek(s, 1);
+	if (!n || n->Int < 0) return; // TODO: ERROR HANDLING
+	Receive(s, n->Int, 2);
+}
+
+/* ( -- ) Lets other tasks run. */
+static void Pause(struct State s)
+{
+	if (s.tasks) TasksPause(s.tasks);
+}
+
+static void HelloWorld(struct State s)
 {
-	puts("Hello, World!");
+	OutputString(s.output, "Hello, World!\n");
 }
 
 static void PopAndPrintIntegral(struct State s)
 {
 	ForthDatum d;
 	if (Pop(s, &d))
-		printf("%ld", d.Int);
+		OutputInt(s.output, d.Int);
+	else {} // TODO: ERROR HANDLING
+}
+
+static void Newline(struct State s)
+{
+	OutputChar(s.output, '\n');
+}
+
+/* ( c -- ) Prints the character whose code is c. */
+static void Emit(struct State s)
+{
+	ForthDatum d;
+	if (Pop(s, &d))
+		OutputChar(s.output, (char)d.Int);
 	else {} // TODO: ERROR HANDLING
 }
 
-static void Newline(struct State _ __attribute__((unused)))
+/* ( -- ) Hands what has been printed on to the terminal, or file. */
+static void Flush(struct State s)
 {
-	putchar('\n');
+	OutputFlush(s.output);
 }
 
 static void Add(struct State s)
@@ -117,65 +455,750 @@ Multiply_d1PopFail:
 	;
 }
 
+static void Subtract(struct State s)
+{
+	ForthDatum d1, d2;
+	if (!Pop2(s, &d1, &d2)) return; // TODO: ERROR HANDLING
+	d1.Int -= d2.Int;
+	Push(s, T_INT, &d1.Int);
+}
+
+static void Equal(struct State s)
+{
+	ForthDatum d1, d2;
+	if (!Pop2(s, &d1, &d2)) return; // TODO: ERROR HANDLING
+	d1.Int = FLAG(d1.Int == d2.Int);
+	Push(s, T_INT, &d1.Int);
+}
+
+static void Less(struct State s)
+{
+	ForthDatum d1, d2;
+	if (!Pop2(s, &d1, &d2)) return; // TODO: ERROR HANDLING
+	d1.Int = FLAG(d1.Int < d2.Int);
+	Push(s, T_INT, &d1.Int);
+}
+
+static void Greater(struct State s)
+{
+	ForthDatum d1, d2;
+	if (!Pop2(s, &d1, &d2)) return; // TODO: ERROR HANDLING
+	d1.Int = FLAG(d1.Int > d2.Int);
+	Push(s, T_INT, &d1.Int);
+}
+
+static void ZeroEqual(struct State s)
+{
+	ForthDatum d;
+	if (!Pop(s, &d)) return; // TODO: ERROR HANDLING
+	d.Int = FLAG(!d.Int);
+	Push(s, T_INT, &d.Int);
+}
+
+/* Strings and vectors are shared, so a duplicate is one more owner, not a
+   copy. */
+static void Dup(struct State s)
+{
+	enum datum_type t;
+	ForthDatum d;
+	if (!PopTyped(s, &t, &d)) return; // TODO: ERROR HANDLING
+	Push(s, t, &d);
+	if (Push(s, t, &d)) Retain(t, d);
+}
+
+static void Drop(struct State s)
+{
+	enum datum_type t;
+	ForthDatum d;
+	if (!PopTyped(s, &t, &d)) return; // TODO: ERROR HANDLING
+	Release(t, d);
+}
+
+static void Swap(struct State s)
+{
+	enum datum_type t1, t2;
+	ForthDatum d1, d2;
+	if (!PopTyped(s, &t2, &d2)) return; // TODO: ERROR HANDLING
+	if (!PopTyped(s, &t1, &d1)) { Push(s, t2, &d2); return; }
+	Push(s, t2, &d2);
+	Push(s, t1, &d1);
+}
+
+static void Over(struct State s)
+{
+	enum datum_type t1, t2;
+	ForthDatum d1, d2;
+	if (!PopTyped(s, &t2, &d2)) return; // TODO: ERROR HANDLING
+	if (!PopTyped(s, &t1, &d1)) { Push(s, t2, &d2); return; }
+	Push(s, t1, &d1);
+	Push(s, t2, &d2);
+	if (Push(s, t1, &d1)) Retain(t1, d1);
+}
+
+static void Rot(struct State s)
+{
+	enum datum_type t1, t2, t3;
+	ForthDatum d1, d2, d3;
+	if (!PopTyped(s, &t3, &d3)) return; // TODO: ERROR HANDLING
+	if (!PopTyped(s, &t2, &d2)) { Push(s, t3, &d3); return; }
+	if (!PopTyped(s, &t1, &d1)) { Push(s, t2, &d2); Push(s, t3, &d3); return; }
+	Push(s, t2, &d2);
+	Push(s, t3, &d3);
+	Push(s, t1, &d1);
+}
+
 static void PrintLn(struct State s)
 {
 	ForthDatum d;
-	if (Pop(s, &d)) {
-		puts(d.String);
-		free(d.String);
-	} else {} // ERROR HANDLING
+	if (!PopString(s, &d)) return;
+	OutputWrite(s.output, StringText(&d), StringLength(d));
+	OutputChar(s.output, '\n');
+	StringRelease(d);
 }
 
 static void Print(struct State s)
 {
 	ForthDatum d;
-	if (Pop(s, &d)) {
-		fputs(d.String, stdout);
-		free(d.String);
-	} else {} // ERROR HANDLING
+	if (!PopString(s, &d)) return;
+	OutputWrite(s.output, StringText(&d), StringLength(d));
+	StringRelease(d);
 }
 
-/********** PUBLIC **********/
-_Bool ImportBuiltins(Dict namespace_to_mutate, _Bool typing_onp) {
-	ForthWord fw; fw.type = F_BUILTIN;
-	char* s;
+/* ( text -- ) Interprets text, as if it had been read in place of the word. */
+static void Evaluate(struct State s)
+{
+	ForthDatum d;
+	if (!PopString(s, &d)) return;
+	void* reader; PALLOCA(reader, StringObjSize());
+	const Reader input = CreateStringObj(reader, StringText(&d));
+	/* What it runs draws on the budget of the word it's run from. */
+	while (Eval(s, input, ErrorHandler) && !ExecuteExhausted(s));
+	DeleteStringObj(reader);
+	StringRelease(d);
+}
 
-	if (typing_onp) {
-		Push = PushWithTypeStack;
-		Pop  = PopWithTypeStack;
-	} else {
-		Push = PushWithoutTypeStack;
-		Pop  = PopWithoutTypeStack;
-	}
+/* The memory of the `n` bytes at the address `at`, or NULL after reporting
+   that they aren't in the data space. */
+static void* Address(struct State s, long at, size_t n)
+{
+	void* p = s.data ? DataAt(s.data, at, n) : NULL;
+	if (!p) OutputError(s.output, "ERROR: Bad address %ld.\n", at);
+	return p;
+}
 
-	/* Add items to the function namespace. */
-	s = pstrdup("HelloWorld");
-	fw.data.builtin = HelloWorld;
-	if(!DictAdd(namespace_to_mutate, &s, &fw)) return false;
+/* Pops a cell to be stored in the data space, which strings and vectors
+   can't be. */
+static _Bool PopCell(struct State s, ForthDatum* d)
+{
+	enum datum_type t;
+	if (!PopTyped(s, &t, d)) return false;
+	if (T_INT == t) return true;
+	OutputError(s.output,
+	            "ERROR: Only numbers can be stored in the data space.\n");
+	Release(t, *d);
+	return false;
+}
 
-	s = pstrdup(".");
-	fw.data.builtin = PopAndPrintIntegral;
-	if(!DictAdd(namespace_to_mutate, &s, &fw)) return false;
+/* ( -- addr ) */
+static void Here(struct State s)
+{
+	ForthDatum d = {.Int = s.data ? DataHere(s.data) : 0};
+	Push(s, T_INT, &d);
+}
+
+/* ( -- addr ) The cell holding the base numbers are read in. */
+static void Base(struct State s)
+{
+	ForthDatum d = {.Int = DATA_BASE};
+	Push(s, T_INT, &d);
+}
+
+/* Sets BASE to `base`. */
+static void SetBase(struct State s, long base)
+{
+	void* p = Address(s, DATA_BASE, sizeof(base));
+	if (p) memcpy(p, &base, sizeof(base));
+}
+
+/* ( -- ) */
+static void Hex(struct State s)
+{
+	SetBase(s, 16);
+}
+
+/* ( -- ) */
+static void Decimal(struct State s)
+{
+	SetBase(s, 10);
+}
+
+/* ( n -- ) Allots n bytes of the data space, or frees them if negative. */
+static void Allot(struct State s)
+{
+	ForthDatum d;
+	if (!Need(s, 1) || !Pop(s, &d)) return;
+	if (!s.data || !DataAllot(s.data, d.Int))
+		OutputError(s.output, "ERROR: Could not allot %ld bytes.\n", d.Int);
+}
+
+/* ( x -- ) Allots a cell, and stores x in it. */
+static void Comma(struct State s)
+{
+	ForthDatum d;
+	if (!Need(s, 1) || !PopCell(s, &d)) return;
+	if (!s.data || !DataAppend(s.data, &d.Int, sizeof(d.Int)))
+		OutputError(s.output, "ERROR: Could not allot a cell.\n");
+}
+
+/* ( n -- n*cell ) */
+static void Cells(struct State s)
+{
+	ForthDatum d;
+	if (!Need(s, 1) || !Pop(s, &d)) return;
+	d.Int *= (long)sizeof(d.Int);
+	Push(s, T_INT, &d);
+}
+
+/* ( addr -- x ) */
+static void Fetch(struct State s)
+{
+	ForthDatum d;
+	if (!Need(s, 1) || !Pop(s, &d)) return;
+	const void* p = Address(s, d.Int, sizeof(d.Int));
+	if (!p) return;
+	memcpy(&d.Int, p, sizeof(d.Int));
+	Push(s, T_INT, &d);
+}
+
+/* ( x addr -- ) */
+static void Store(struct State s)
+{
+	ForthDatum at, d;
+	if (!Need(s, 2)) return;
+	Pop(s, &at);
+	if (!PopCell(s, &d)) return;
+	void* p = Address(s, at.Int, sizeof(d.Int));
+	if (p) memcpy(p, &d.Int, sizeof(d.Int));
+}
+
+/* ( addr -- c ) */
+static void CFetch(struct State s)
+{
+	ForthDatum d;
+	if (!Need(s, 1) || !Pop(s, &d)) return;
+	const unsigned char* p = Address(s, d.Int, 1);
+	if (!p) return;
+	d.Int = *p;
+	Push(s, T_INT, &d);
+}
+
+/* ( c addr -- ) */
+static void CStore(struct State s)
+{
+	ForthDatum at, d;
+	if (!Need(s, 2)) return;
+	Pop(s, &at);
+	if (!PopCell(s, &d)) return;
+	unsigned char* p = Address(s, at.Int, 1);
+	if (p) *p = (unsigned char)d.Int;
+}
 
-	s = pstrdup("+");
-	fw.data.builtin = Add;
-	if(!DictAdd(namespace_to_mutate, &s, &fw)) return false;
+/* ( F: r1 r2 -- r3 ) */
+static void FAdd(struct State s)
+{
+	double f1, f2;
+	if (!PopFloat2(s, &f1, &f2)) return;
+	PushFloat(s, f1 + f2);
+}
+
+static void FSubtract(struct State s)
+{
+	double f1, f2;
+	if (!PopFloat2(s, &f1, &f2)) return;
+	PushFloat(s, f1 - f2);
+}
+
+static void FMultiply(struct State s)
+{
+	double f1, f2;
+	if (!PopFloat2(s, &f1, &f2)) return;
+	PushFloat(s, f1 * f2);
+}
+
+static void FDivide(struct State s)
+{
+	double f1, f2;
+	if (!PopFloat2(s, &f1, &f2)) return;
+	PushFloat(s, f1 / f2);
+}
+
+/* ( F: r -- ) */
+static void FPrint(struct State s)
+{
+	double f;
+	if (PopFloat(s, &f))
+		OutputFloat(s.output, f);
+}
+
+static void FDup(struct State s)
+{
+	double f;
+	if (!PopFloat(s, &f)) return;
+	PushFloat(s, f);
+	PushFloat(s, f);
+}
+
+static void FDrop(struct State s)
+{
+	PopFloat(s, NULL);
+}
 
-	s = pstrdup("*");
-	fw.data.builtin = Multiply;
-	if(!DictAdd(namespace_to_mutate, &s, &fw)) return false;
+static void FSwap(struct State s)
+{
+	double f1, f2;
+	if (!PopFloat2(s, &f1, &f2)) return;
+	PushFloat(s, f2);
+	PushFloat(s, f1);
+}
+
+static void FOver(struct State s)
+{
+	double f1, f2;
+	if (!PopFloat2(s, &f1, &f2)) return;
+	PushFloat(s, f1);
+	PushFloat(s, f2);
+	PushFloat(s, f1);
+}
+
+/* ( -- flag ) ( F: r1 r2 -- ) */
+static void FLess(struct State s)
+{
+	double f1, f2;
+	if (!PopFloat2(s, &f1, &f2)) return;
+	ForthDatum d = {.Int = FLAG(f1 < f2)};
+	Push(s, T_INT, &d);
+}
+
+/* ( -- flag ) ( F: r -- ) */
+static void FZeroEqual(struct State s)
+{
+	double f;
+	if (!PopFloat(s, &f)) return;
+	ForthDatum d = {.Int = FLAG(0 == f)};
+	Push(s, T_INT, &d);
+}
 
-	s = pstrdup("nl");
-	fw.data.builtin = Newline;
-	if(!DictAdd(namespace_to_mutate, &s, &fw)) return false;
+/* ( n -- ) ( F: -- r ) */
+static void SToF(struct State s)
+{
+	ForthDatum d;
+	if (!Need(s, 1) || !Pop(s, &d)) return;
+	PushFloat(s, (double)d.Int);
+}
 
-	s = pstrdup("PrintLn");
-	fw.data.builtin = PrintLn;
-	if(!DictAdd(namespace_to_mutate, &s, &fw)) return false;
+/* ( -- n ) ( F: r -- ) Truncates towards zero. */
+static void FToS(struct State s)
+{
+	double f;
+	if (!PopFloat(s, &f)) return;
+	if (!(f >= (double)LONG_MIN && f < (double)LONG_MAX)) {
+		OutputError(s.output, "ERROR: %g doesn't fit in a cell.\n", f);
+		return; }
+	ForthDatum d = {.Int = (long)f};
+	Push(s, T_INT, &d);
+}
 
-	s = pstrdup("Print");
-	fw.data.builtin = Print;
-	if(!DictAdd(namespace_to_mutate, &s, &fw)) return false;
+/* ( addr -- ) ( F: -- r ) */
+static void FFetch(struct State s)
+{
+	ForthDatum d;
+	double f;
+	if (!Need(s, 1) || !Pop(s, &d)) return;
+	const void* p = Address(s, d.Int, sizeof(f));
+	if (!p) return;
+	memcpy(&f, p, sizeof(f));
+	PushFloat(s, f);
+}
 
+/* ( addr -- ) ( F: r -- ) */
+static void FStore(struct State s)
+{
+	ForthDatum at;
+	double f;
+	if (!Need(s, 1) || !NeedFloats(s, 1)) return;
+	Pop(s, &at);
+	PopFloat(s, &f);
+	void* p = Address(s, at.Int, sizeof(f));
+	if (p) memcpy(p, &f, sizeof(f));
+}
+
+/* ( n -- n*float ) */
+static void Floats(struct State s)
+{
+	ForthDatum d;
+	if (!Need(s, 1) || !Pop(s, &d)) return;
+	d.Int *= (long)sizeof(double);
+	Push(s, T_INT, &d);
+}
+
+/* The bulk memory words leave the byte loops to the C library, whose
+   routines are vectorized, and pick the best kernel for the CPU at load
+   time. */
+
+/* Sets `*p` to the memory of the `n` bytes at `at`, or NULL if `n` is 0,
+   in which case any address will do. Returns false after reporting a bad
+   range. */
+static _Bool Bytes(struct State s, long at, long n, unsigned char** p)
+{
+	*p = NULL;
+	if (n < 0) {
+		OutputError(s.output, "ERROR: Bad length %ld.\n", n);
+		return false; }
+	return !n || (*p = Address(s, at, (size_t)n));
+}
+
+/* ( addr u c -- ) */
+static void Fill(struct State s)
+{
+	ForthDatum at, n, c;
+	unsigned char* p;
+	if (!Need(s, 3)) return;
+	Pop(s, &c);
+	Pop2(s, &at, &n);
+	if (Bytes(s, at.Int, n.Int, &p) && p) memset(p, (unsigned char)c.Int, n.Int);
+}
+
+/* ( from to u -- ) Copies as if through a buffer, whatever the overlap. */
+static void Move(struct State s)
+{
+	ForthDatum from, to, n;
+	unsigned char *src, *dst;
+	if (!Need(s, 3)) return;
+	Pop(s, &n);
+	Pop2(s, &from, &to);
+	if (Bytes(s, from.Int, n.Int, &src) && Bytes(s, to.Int, n.Int, &dst) && dst)
+		memmove(dst, src, n.Int);
+}
+
+/* ( from to u -- ) Copies as if a byte at a time, from the lowest address
+   up, so that copying up into an overlap repeats the leading bytes. */
+static void CMove(struct State s)
+{
+	ForthDatum from, to, n;
+	unsigned char *src, *dst;
+	if (!Need(s, 3)) return;
+	Pop(s, &n);
+	Pop2(s, &from, &to);
+	if (!Bytes(s, from.Int, n.Int, &src) || !Bytes(s, to.Int, n.Int, &dst) ||
+	    !dst) return;
+	const size_t len = n.Int, gap = dst - src;
+	if (dst <= src || gap >= len) {
+		memmove(dst, src, len);
+		return; }
+	/* The first `gap` bytes repeat: copy them in doubling runs. */
+	const size_t end = gap + len;
+	for (size_t done = gap; done < end; done *= 2)
+		memcpy(src + done, src, done < end - done ? done : end - done);
+}
+
+/* ( addr1 u1 addr2 u2 -- n ) -1, 0 or 1 as the first string sorts before,
+   the same as or after the second. */
+static void Compare(struct State s)
+{
+	ForthDatum at1, n1, at2, n2;
+	unsigned char *p1, *p2;
+	if (!Need(s, 4)) return;
+	Pop2(s, &at2, &n2);
+	Pop2(s, &at1, &n1);
+	if (!Bytes(s, at1.Int, n1.Int, &p1) || !Bytes(s, at2.Int, n2.Int, &p2))
+		return;
+	const long n = n1.Int < n2.Int ? n1.Int : n2.Int;
+	int diff = n ? memcmp(p1, p2, n) : 0;
+	if (!diff) diff = (n1.Int > n2.Int) - (n1.Int < n2.Int);
+	ForthDatum d = {.Int = (diff > 0) - (diff < 0)};
+	Push(s, T_INT, &d);
+}
+
+/* ( addr1 u1 addr2 u2 -- addr3 u3 flag ) Finds the second string in the
+   first, leaving what remains of the first from there on, and true; or the
+   first, and false. */
+static void Search(struct State s)
+{
+	ForthDatum at1, n1, at2, n2;
+	unsigned char *p1, *p2;
+	if (!Need(s, 4)) return;
+	Pop2(s, &at2, &n2);
+	Pop2(s, &at1, &n1);
+	if (!Bytes(s, at1.Int, n1.Int, &p1) || !Bytes(s, at2.Int, n2.Int, &p2))
+		return;
+	ForthDatum found = {.Int = FLAG(!n2.Int)};
+	for (long i = 0; !found.Int && n2.Int <= n1.Int - i; ++i) {
+		/* Skip to the next candidate's first byte. */
+		const unsigned char* c = memchr(p1 + i, *p2, n1.Int - n2.Int - i + 1);
+		if (!c) break;
+		i = c - p1;
+		if (!memcmp(c + 1, p2 + 1, n2.Int - 1)) {
+			found.Int = FLAG(true);
+			at1.Int += i;
+			n1.Int -= i; }}
+	Push(s, T_INT, &at1);
+	Push(s, T_INT, &n1);
+	Push(s, T_INT, &found);
+}
+
+/* Pops a vector, after reporting it if it's missing, or something else. */
+static _Bool PopVector(struct State s, struct Vector** v)
+{
+	enum datum_type t;
+	ForthDatum d;
+	if (!PopTyped(s, &t, &d)) {
+		Underflow(s);
+		return false; }
+	if (s.types && T_VECTOR != t) {
+		OutputError(s.output, "ERROR: Expected a vector.\n");
+		Release(t, d);
+		return false; }
+	*v = d.Vector;
 	return true;
 }
+
+/* Pops two vectors of the same length and kind. */
+static _Bool PopVectors(struct State s, struct Vector** v1, struct Vector** v2)
+{
+	if (!Need(s, 2) || !PopVector(s, v2)) return false;
+	if (!PopVector(s, v1)) {
+		VectorRelease(*v2);
+		return false; }
+	if ((*v1)->kind != (*v2)->kind)
+		OutputError(s.output,
+		            "ERROR: Vectors of cells and floats don't mix.\n");
+	else if ((*v1)->length == (*v2)->length) return true;
+	else OutputError(s.output,
+	                 "ERROR: Vectors of lengths %lu and %lu don't match.\n",
+	                 (*v1)->length, (*v2)->length);
+	VectorRelease(*v1);
+	VectorRelease(*v2);
+	return false;
+}
+
+/* ( addr u -- v ) Makes a vector of the u cells, or floats, at addr. */
+static void FetchVector(struct State s, enum vector_kind kind)
+{
+	ForthDatum at, n;
+	unsigned char* p;
+	if (!Need(s, 2)) return;
+	Pop2(s, &at, &n);
+	if (n.Int > LONG_MAX / (long)sizeof(long)) n.Int = -1;
+	if (!Bytes(s, at.Int, n.Int * (long)sizeof(long), &p)) return;
+	ForthDatum d = {.Vector = VectorNew(n.Int, kind)};
+	if (!d.Vector) {
+		OutputError(s.output, "ERROR: Out of memory.\n");
+		return; }
+	if (p) memcpy(d.Vector->elements, p, n.Int * sizeof(long));
+	if (!Push(s, T_VECTOR, &d)) VectorRelease(d.Vector);
+}
+
+static void VFetch(struct State s)
+{
+	FetchVector(s, V_CELLS);
+}
+
+/* ( addr u -- v ) */
+static void FVFetch(struct State s)
+{
+	FetchVector(s, V_FLOATS);
+}
+
+/* ( v addr -- ) Stores the elements of v from addr on. */
+static void VStore(struct State s)
+{
+	ForthDatum at;
+	struct Vector* v;
+	unsigned char* p;
+	if (!Need(s, 2)) return;
+	Pop(s, &at);
+	if (!PopVector(s, &v)) return;
+	if (Bytes(s, at.Int, v->length * sizeof(long), &p) && p)
+		memcpy(p, v->elements, v->length * sizeof(long));
+	VectorRelease(v);
+}
+
+/* ( v -- u ) */
+static void VLength(struct State s)
+{
+	struct Vector* v;
+	if (!PopVector(s, &v)) return;
+	ForthDatum d = {.Int = v->length};
+	VectorRelease(v);
+	Push(s, T_INT, &d);
+}
+
+/* ( v -- n ) or ( v -- ) ( F: -- r ) The sum of the elements. */
+static void VSum(struct State s)
+{
+	struct Vector* v;
+	if (!PopVector(s, &v)) return;
+	if (V_FLOATS == v->kind) PushFloat(s, VectorFSum(v));
+	else {
+		ForthDatum d = {.Int = VectorSum(v)};
+		Push(s, T_INT, &d); }
+	VectorRelease(v);
+}
+
+/* ( v1 v2 -- n ) or ( v1 v2 -- ) ( F: -- r ) The sum of the products of
+   the elements. */
+static void VDot(struct State s)
+{
+	struct Vector *v1, *v2;
+	if (!PopVectors(s, &v1, &v2)) return;
+	if (V_FLOATS == v1->kind) PushFloat(s, VectorFDot(v1, v2));
+	else {
+		ForthDatum d = {.Int = VectorDot(v1, v2)};
+		Push(s, T_INT, &d); }
+	VectorRelease(v1);
+	VectorRelease(v2);
+}
+
+/* ( v1 v2 -- v3 ) Applies `kernel` to the elements of v1 and v2 in turn. */
+static void Map(struct State s, void (*kernel)(struct Vector*,
+                                               const struct Vector*,
+                                               const struct Vector*))
+{
+	struct Vector *v1, *v2;
+	if (!PopVectors(s, &v1, &v2)) return;
+	/* A vector nothing else owns can be written over. */
+	ForthDatum d = {.Vector = 1 == v1->refs ? v1
+	                        : 1 == v2->refs ? v2
+	                        : VectorNew(v1->length, v1->kind)};
+	if (d.Vector) kernel(d.Vector, v1, v2);
+	else OutputError(s.output, "ERROR: Out of memory.\n");
+	if (d.Vector != v1) VectorRelease(v1);
+	if (d.Vector != v2) VectorRelease(v2);
+	if (d.Vector && !Push(s, T_VECTOR, &d)) VectorRelease(d.Vector);
+}
+
+static void VAdd(struct State s)
+{
+	Map(s, VectorAdd);
+}
+
+static void VMul(struct State s)
+{
+	Map(s, VectorMul);
+}
+
+static void VMax(struct State s)
+{
+	Map(s, VectorMax);
+}
+
+/* Names under which the builtins are imported. */
+static const struct {
+	const char* name;
+	void (*builtin)(struct State);
+} Builtins[] = {
+	{"HelloWorld", HelloWorld},
+	{".",          PopAndPrintIntegral},
+	{"+",          Add},
+	{"-",          Subtract},
+	{"*",          Multiply},
+	{"=",          Equal},
+	{"<",          Less},
+	{">",          Greater},
+	{"0=",         ZeroEqual},
+	{"DUP",        Dup},
+	{"DROP",       Drop},
+	{"SWAP",       Swap},
+	{"OVER",       Over},
+	{"ROT",        Rot},
+	{"nl",         Newline},
+	{"PrintLn",    PrintLn},
+	{"Print",      Print},
+	{"TYPE",       Print},
+	{"EMIT",       Emit},
+	{"FLUSH",      Flush},
+	{"EVALUATE",   Evaluate},
+	{"HERE",       Here},
+	{"ALLOT",      Allot},
+	{"BASE",       Base},
+	{"HEX",        Hex},
+	{"DECIMAL",    Decimal},
+	{",",          Comma},
+	{"CELLS",      Cells},
+	{"@",          Fetch},
+	{"!",          Store},
+	{"C@",         CFetch},
+	{"C!",         CStore},
+	{"F+",         FAdd},
+	{"F-",         FSubtract},
+	{"F*",         FMultiply},
+	{"F/",         FDivide},
+	{"F.",         FPrint},
+	{"FDUP",       FDup},
+	{"FDROP",      FDrop},
+	{"FSWAP",      FSwap},
+	{"FOVER",      FOver},
+	{"F<",         FLess},
+	{"F0=",        FZeroEqual},
+	{"S>F",        SToF},
+	{"F>S",        FToS},
+	{"F@",         FFetch},
+	{"F!",         FStore},
+	{"FLOATS",     Floats},
+	{"FILL",       Fill},
+	{"MOVE",       Move},
+	{"CMOVE",      CMove},
+	{"COMPARE",    Compare},
+	{"SEARCH",     Search},
+	{"V@",         VFetch},
+	{"FV@",        FVFetch},
+	{"V!",         VStore},
+	{"VLEN",       VLength},
+	{"VSUM",       VSum},
+	{"VDOT",       VDot},
+	{"VADD",       VAdd},
+	{"VMUL",       VMul},
+	{"VMAX",       VMax},
+	{"SAVE-IMAGE", SaveImage},
+	{"SPAWN",      Spawn},
+	{"PAUSE",      Pause},
+	{"SPAWN-N",    SpawnN},
+	{"THREAD",     Thread},
+	{"THREAD-N",   ThreadN},
+	{"CHAN",       Chan},
+	{"CHAN-FREE",  ChanFree},
+	{">CHAN",      ToChan},
+	{"CHAN>",      FromChan},
+	{"N>CHAN",     ToChanN},
+	{"CHAN>N",     FromChanN},
+};
+
+/********** PUBLIC **********/
+_Bool ImportBuiltins(Dict namespace_to_mutate) {
+	ForthWord fw; fw.type = F_BUILTIN;
+	char* s;
+
+	/* Add items to the function namespace. */
+	for (size_t i = 0; i < sizeof(Builtins)/sizeof(*Builtins); ++i) {
+		if (!(s = pstrdup(Builtins[i].name))) return false;
+		fw.data.builtin = Builtins[i].builtin;
+		if(!DictAdd(namespace_to_mutate, &s, &fw)) {
+			free(s);
+			return false; }}
+
+	return true;
+}
+
+const char* BuiltinName(void (*builtin)(struct State))
+{
+	for (size_t i = 0; i < sizeof(Builtins)/sizeof(*Builtins); ++i)
+		if (Builtins[i].builtin == builtin) return Builtins[i].name;
+	return NULL;
+}
+
+void (*BuiltinNamed(const char* name))(struct State)
+{
+	for (size_t i = 0; i < sizeof(Builtins)/sizeof(*Builtins); ++i)
+		if (!strcmp(Builtins[i].name, name)) return Builtins[i].builtin;
+	return NULL;
+}
@@ -1,8 +1,16 @@
 #ifndef BUILTINS_H
 #define BUILTINS_H
 #include "Dict.h"
+#include "ForthTypes.h"
 
 /* Returns false on failure, true otherwise. */
-_Bool ImportBuiltins(Dict namespace_to_mutate, _Bool typing_onp);
+_Bool ImportBuiltins(Dict namespace_to_mutate);
+
+/* Returns the name `builtin` is imported under, or NULL if it isn't one. */
+const char* BuiltinName(void (*builtin)(struct State));
+
+/* Returns the builtin imported under `name`, or NULL if there is none. */
+/* Unlike a namespace lookup, this is unaffected by redefinitions. */
+void (*BuiltinNamed(const char* name))(struct State);
 
 #endif /* BUILTINS_H */
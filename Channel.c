@@ -0,0 +1,266 @@
+#include <stdlib.h> // malloc, free
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "Channel.h"
+#include "Assert.h"
+#include "ForthTypes.h"
+#include "ForthString.h"
+#include "ForthVector.h"
+
+/* Keeps what each end writes on cache lines of its own. */
+#define LINE 64
+
+struct cell {
+	ForthDatum d;
+	enum datum_type type;
+};
+
+struct Channel {
+	_Atomic unsigned long refs; /* Its table's, and each word using it. */
+	_Atomic _Bool closed;       /* Whether its handle has been closed. */
+
+	/// The receiver's end.
+	_Alignas(LINE) _Atomic size_t head; /* Count of items ever received. */
+	size_t tailSeen;                     /* Last value of `tail` it loaded. */
+
+	/// The sender's end.
+	_Alignas(LINE) _Atomic size_t tail; /* Count of items ever sent. */
+	size_t headSeen;                     /* Last value of `head` it loaded. */
+
+	_Alignas(LINE) size_t mask;         /* Capacity, less one. */
+	struct cell cells[];
+};
+
+/* Channels are named to Forth by handles into a table: a slot, and how
+   many times it has been freed, so that a handle can't be mistaken for a
+   later channel in the same slot. */
+#define SLOT_BITS 16
+#define SLOTS     (1UL << SLOT_BITS)
+struct slot {
+	struct Channel* channel;   /* NULL while free. */
+	unsigned long generation;  /* At least 1 once used. */
+	unsigned long next;        /* While free, the next free slot. */
+};
+
+struct Channels {
+	pthread_mutex_t lock;      /* Held for any use of the slots. */
+	struct slot* slots;        /* Grown as need be, up to SLOTS. */
+	unsigned long size, used;  /* Slots allocated, and ever used. */
+	unsigned long free;        /* First free slot, or SLOTS for none. */
+	_Atomic unsigned long threads; /* See ChannelsEnter. */
+};
+
+Channel ChannelNew(size_t capacity)
+{
+	size_t n = 1;
+	while (n < capacity) {
+		if (n > ((size_t)-1 >> 1) / sizeof(struct cell)) return NULL;
+		n <<= 1; }
+
+	Channel c = aligned_alloc(LINE, (sizeof(struct Channel) +
+	                                 n * sizeof(struct cell) + LINE - 1)
+	                                / LINE * LINE);
+	if (!c) return NULL;
+	atomic_init(&c->refs, 1);
+	atomic_init(&c->closed, false);
+	atomic_init(&c->head, 0);
+	atomic_init(&c->tail, 0);
+	c->tailSeen = c->headSeen = 0;
+	c->mask = n - 1;
+	return c;
+}
+
+size_t ChannelCapacity(const Channel c)
+{
+	cassert(c);
+	return c->mask + 1;
+}
+
+_Bool ChannelSend(Channel c, const ForthDatum* data,
+                  const enum datum_type* types, size_t n)
+{
+	cassert(c);
+	cassert(data || !n);
+
+	const size_t tail = atomic_load_explicit(&c->tail, memory_order_relaxed);
+	/* The receiver's progress is only loaded when what was last seen of it
+	   doesn't leave enough room. */
+	if (c->mask + 1 - (tail - c->headSeen) < n) {
+		c->headSeen = atomic_load_explicit(&c->head, memory_order_acquire);
+		if (c->mask + 1 - (tail - c->headSeen) < n) return false; }
+
+	for (size_t i = 0; i < n; ++i) {
+		struct cell* cell = &c->cells[(tail + i) & c->mask];
+		cell->d    = data[i];
+		cell->type = types ? types[i] : T_INT; }
+	atomic_store_explicit(&c->tail, tail + n, memory_order_release);
+	return true;
+}
+
+_Bool ChannelReceive(Channel c, ForthDatum* data, enum datum_type* types,
+                     size_t n)
+{
+	cassert(c);
+	cassert(data || !n);
+
+	const size_t head = atomic_load_explicit(&c->head, memory_order_relaxed);
+	if (c->tailSeen - head < n) {
+		c->tailSeen = atomic_load_explicit(&c->tail, memory_order_acquire);
+		if (c->tailSeen - head < n) return false; }
+
+	for (size_t i = 0; i < n; ++i) {
+		const struct cell* cell = &c->cells[(head + i) & c->mask];
+		data[i] = cell->d;
+		if (types) types[i] = cell->type; }
+	atomic_store_explicit(&c->head, head + n, memory_order_release);
+	return true;
+}
+
+size_t ChannelsSize(void)
+{
+	return sizeof(struct Channels);
+}
+
+Channels ChannelsNew(void* memory)
+{
+	cassert(memory);
+	if (!memory) return NULL;
+
+	Channels t = memory;
+	*t = (struct Channels){.slots = NULL, .size = 0, .used = 0, .free = SLOTS};
+	atomic_init(&t->threads, 0);
+	pthread_mutex_init(&t->lock, NULL);
+	return t;
+}
+
+void ChannelsDelete(Channels t)
+{
+	cassert(t);
+	for (unsigned long i = 0; i < t->used; ++i)
+		if (t->slots[i].channel) ChannelRelease(t->slots[i].channel);
+	free(t->slots);
+	pthread_mutex_destroy(&t->lock);
+}
+
+void ChannelsEnter(Channels t)
+{
+	cassert(t);
+	++t->threads;
+}
+
+void ChannelsLeave(Channels t)
+{
+	cassert(t);
+	--t->threads;
+}
+
+_Bool ChannelsShared(const Channels t)
+{
+	cassert(t);
+	return t->threads;
+}
+
+/* Makes room for another slot. Returns false if there can be no more. */
+static _Bool Grow(Channels t)
+{
+	if (t->used < t->size) return true;
+	if (SLOTS == t->size) return false;
+	const unsigned long size = t->size ? 2 * t->size : 16;
+	struct slot* slots = realloc(t->slots, size * sizeof(struct slot));
+	if (!slots) return false;
+	t->slots = slots;
+	t->size  = size;
+	return true;
+}
+
+long ChannelOpen(Channels t, size_t capacity)
+{
+	cassert(t);
+	Channel c = ChannelNew(capacity);
+	if (!c) return 0;
+
+	pthread_mutex_lock(&t->lock);
+	unsigned long slot;
+	if (SLOTS != t->free) {
+		slot = t->free;
+		t->free = t->slots[slot].next; }
+	else if (Grow(t)) {
+		slot = t->used++;
+		t->slots[slot].generation = 1; }
+	else {
+		pthread_mutex_unlock(&t->lock);
+		ChannelDelete(c);
+		return 0; }
+	t->slots[slot].channel = c;
+	const unsigned long generation = t->slots[slot].generation;
+	pthread_mutex_unlock(&t->lock);
+	return (long)(generation << SLOT_BITS | slot);
+}
+
+/* Returns the slot `handle` names in `t`, whose lock is held, or NULL if
+   it names none, or a slot freed since. */
+static struct slot* Find(Channels t, long handle)
+{
+	if (handle <= 0) return NULL;
+	const unsigned long slot = (unsigned long)handle & (SLOTS - 1);
+	const unsigned long generation = (unsigned long)handle >> SLOT_BITS;
+	if (slot >= t->used || t->slots[slot].generation != generation)
+		return NULL;
+	return t->slots[slot].channel ? &t->slots[slot] : NULL;
+}
+
+Channel ChannelFind(Channels t, long handle)
+{
+	cassert(t);
+	pthread_mutex_lock(&t->lock);
+	const struct slot* found = Find(t, handle);
+	const Channel c = found ? found->channel : NULL;
+	if (c) atomic_fetch_add(&c->refs, 1);
+	pthread_mutex_unlock(&t->lock);
+	return c;
+}
+
+_Bool ChannelClosed(const Channel c)
+{
+	cassert(c);
+	return atomic_load(&c->closed);
+}
+
+void ChannelRelease(Channel c)
+{
+	cassert(c);
+	if (1 == atomic_fetch_sub(&c->refs, 1)) ChannelDelete(c);
+}
+
+_Bool ChannelClose(Channels t, long handle)
+{
+	cassert(t);
+	pthread_mutex_lock(&t->lock);
+	struct slot* found = Find(t, handle);
+	const Channel c = found ? found->channel : NULL;
+	if (found) {
+		found->channel = NULL;
+		++found->generation;
+		found->next = t->free;
+		t->free = (unsigned long)(found - t->slots); }
+	pthread_mutex_unlock(&t->lock);
+	/* Words still using it, on other threads, free it once they're done. */
+	if (c) {
+		atomic_store(&c->closed, true);
+		ChannelRelease(c); }
+	return c;
+}
+
+void ChannelDelete(Channel c)
+{
+	cassert(c);
+	const size_t tail = atomic_load(&c->tail);
+	for (size_t i = atomic_load(&c->head); i != tail; ++i)
+		if (T_STRING == c->cells[i & c->mask].type)
+			StringRelease(c->cells[i & c->mask].d);
+		else if (T_VECTOR == c->cells[i & c->mask].type)
+			VectorRelease(c->cells[i & c->mask].d.Vector);
+	free(c);
+}
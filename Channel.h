@@ -0,0 +1,78 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+#include <stddef.h>
+#include "ForthTypes.h"
+
+/* A bounded queue of stack items, from one sender to one receiver, which
+   can be on different threads: a ring buffer without locks. */
+/* The sender only ever writes the tail, and the receiver the head, so each
+   transfer costs one atomic load and one atomic store, however many items
+   it moves. */
+typedef struct Channel* Channel;
+
+/* Makes a channel holding at least `capacity` items, rounded up to a power
+   of two. Returns NULL on failed allocation. */
+Channel ChannelNew(size_t capacity);
+
+size_t ChannelCapacity(const Channel c);
+
+/* Sends the `n` items of `data`, whose types are in `types` (which can be
+   NULL, for all T_INT), or none of them if there isn't room for all. */
+/* The channel takes over the strings sent. Only call from the sender. */
+_Bool ChannelSend(Channel c, const ForthDatum* data,
+                  const enum datum_type* types, size_t n);
+
+/* Receives `n` items, oldest first, into `data` and `types` (which can be
+   NULL), or none of them if fewer than `n` have been sent. */
+/* Only call from the receiver. */
+_Bool ChannelReceive(Channel c, ForthDatum* data, enum datum_type* types,
+                     size_t n);
+
+/* Frees a channel, and the strings still in it. Neither end may be using
+   it any more. */
+void ChannelDelete(Channel c);
+
+/* Forth code only sees channels by handle, which are checked, so that any
+   number can be given to channel words without harm. */
+/* Handles are into a table of channels, one per session, with the tasks
+   and threads it starts, so a session only ever reaches its own. */
+typedef struct Channels* Channels;
+
+size_t ChannelsSize(void);
+
+Channels ChannelsNew(void* memory);
+
+/* Closes the channels still open. */
+void ChannelsDelete(Channels t);
+
+/* Words on threads of their own, as THREAD and PAR-DO start, are counted
+   with the channels they can reach: ChannelsEnter is called before starting
+   such a thread, and ChannelsLeave once it's done, or couldn't be started. */
+void ChannelsEnter(Channels t);
+void ChannelsLeave(Channels t);
+
+/* Returns true if any such thread is running, and so could be at the other
+   end of a channel of `t`. */
+_Bool ChannelsShared(const Channels t);
+
+/* As ChannelNew, but returns a handle of the channel in `t`, or 0 on
+   failure, as once `t` holds 65536 channels. */
+long ChannelOpen(Channels t, size_t capacity);
+
+/* Returns the channel `handle` names in `t`, or NULL if it names none, or
+   one that has been closed. */
+/* It stays valid, even if closed meanwhile, until given to ChannelRelease. */
+Channel ChannelFind(Channels t, long handle);
+
+/* Returns true once the handle it was found by has been closed, after
+   which no more can be sent or received through it. */
+_Bool ChannelClosed(const Channel c);
+
+/* Gives up a channel found by ChannelFind. */
+void ChannelRelease(Channel c);
+
+/* Closes the handle, freeing the channel once nothing found through it is
+   in use any more. Returns false if it names no channel. */
+_Bool ChannelClose(Channels t, long handle);
+
+#endif /* CHANNEL_H */
@@ -1,9 +1,10 @@
 #include <stdbool.h>
-#include <stdlib.h> // free
 #include <stdio.h>
 
 #include "CleanLeaks.h"
 #include "ForthTypes.h"
+#include "ForthString.h"
+#include "ForthVector.h"
 #include "Assert.h"
 
 void CleanLeaks(Stack main, Stack types,
@@ -22,7 +23,11 @@ void CleanLeaks(Stack main, Stack types,
 			break;
 		case T_STRING:
 			StackPop(main, &fd);
-			free(fd.String);
+			StringRelease(fd);
+			break;
+		case T_VECTOR:
+			StackPop(main, &fd);
+			VectorRelease(fd.Vector);
 			break;
 		default:
 			fprintf(stderr, "BUG: Unhandled or bad enum datum_type instance %d "
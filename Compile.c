@@ -0,0 +1,829 @@
+#include <stdio.h>
+#include <stdlib.h> // free
+#include <string.h> // strcmp, memcmp, memcpy, strlen
+#include <stdbool.h>
+
+#include "Dict.h"
+#include "Stack.h"
+#include "Alloca.h"
+#include "Assert.h"
+#include "ForthTypes.h"
+#include "Definition.h"
+#include "Execute.h"
+#include "ForthString.h"
+#include "Compile.h"
+#include "Eval.h"
+#include "Session.h"
+#include "DataSpace.h"
+#include "Output.h"
+
+#include "Debug.h"
+#include "Strdup.h"
+
+/* Definitions of at most this many instructions, not counting their
+   I_EXIT, are copied into their callers rather than called. */
+#define INLINE_SIZE 8
+
+/* Unresolved control structures, innermost last. */
+/* A frame of locals is kept beneath everything else, as C_LOCALS, opened
+   by its I_LOCALS; C_TO awaits the name of a local following TO. */
+enum control_type { C_IF, C_ELSE, C_DO, C_BEGIN, C_WHILE, C_PARDO, C_COMBINE,
+                    C_LOCALS, C_TO };
+struct control {
+	enum control_type type;
+	size_t at; /* Index of the instruction that opened the structure. */
+};
+
+/********** PRIVATE: UTILITY FUNCTIONS **********/
+static inline size_t Here(Stack code)
+{
+	return StackDepth(code);
+}
+
+static inline Instruction* At(Stack code, size_t idx)
+{
+	iassert(idx < StackDepth(code));
+	return (Instruction*)StackPeek(code) + idx;
+}
+
+static _Bool Emit(Stack code, enum instruction_type type, long operand)
+{
+	Instruction in;
+	in.type = type;
+	in.data.Int = operand;
+	return StackPush(code, &in);
+}
+
+/* Resolves the forward branch at `at` to jump to the next instruction. */
+static inline void Resolve(Stack code, size_t at)
+{
+	At(code, at)->data.offset = (long)Here(code) - (long)at;
+}
+
+/* Emits a branch back to `target`. */
+static inline _Bool EmitBack(Stack code, enum instruction_type type,
+                             size_t target)
+{
+	return Emit(code, type, (long)target - (long)Here(code));
+}
+
+static inline _Bool PushControl(Stack control, enum control_type type,
+                                size_t at)
+{
+	struct control c = {type, at};
+	return StackPush(control, &c);
+}
+
+/* Pops the innermost structure, if its type is among `mask`. */
+#define MASK(type) (1u << (type))
+static _Bool PopControl(Stack control, unsigned mask, struct control* c)
+{
+	if (StackIsEmpty(control)) return false;
+	*c = ((struct control*)StackPeek(control))[StackDepth(control) - 1];
+	if (!(mask & MASK(c->type))) return false;
+	return StackPop(control, NULL);
+}
+
+/* Returns true if the innermost structure is of type `type`. */
+static inline _Bool Within(Stack control, enum control_type type)
+{
+	return control && !StackIsEmpty(control) &&
+		type == ((struct control*)StackPeek(control))[StackDepth(control) - 1].type;
+}
+
+/* Returns how many loops enclose the current point of compilation. */
+/* Unless `parallel`, stops at the innermost PAR-DO, whose body is run
+   apart from the rest of the definition. */
+static unsigned long LoopDepth(Stack control, _Bool parallel)
+{
+	unsigned long n = 0;
+	const struct control* cs = StackPeek(control);
+	for (size_t i = StackDepth(control); i--; )
+		if (C_DO == cs[i].type) ++n;
+		else if (C_PARDO == cs[i].type) {
+			if (!parallel) break;
+			++n; }
+	return n;
+}
+
+/* Returns how many locals the definition has a frame of. */
+static long FrameSize(Stack code, Stack control)
+{
+	const struct control* cs = StackPeek(control);
+	return !StackIsEmpty(control) && C_LOCALS == cs[0].type
+		? At(code, cs[0].at)->data.Int : 0;
+}
+
+/* Returns the index of the local named `word`, or -1. Later locals hide
+   earlier ones of the same name. */
+static long Local(Stack locals, const char* word)
+{
+	if (!locals) return -1;
+	char* const* names = StackPeek(locals);
+	for (size_t i = StackDepth(locals); i--; )
+		if (!strcmp(word, names[i])) return (long)i;
+	return -1;
+}
+
+static void FreeName(void* name)
+{
+	free(*(char**)name);
+}
+
+static void Report(struct State state,
+                   void(*handleError)(struct Output*, struct error),
+                   enum error_type type, const char* bad_string)
+{
+	if (handleError)
+		handleError(state.output,
+		            (struct error){.type = type, .bad_string = bad_string});
+}
+
+/********** PRIVATE: CONTROL WORDS **********/
+/* Each returns false if the structure is unbalanced, or on failed allocation.*/
+static _Bool If(Stack code, Stack control)
+{
+	return PushControl(control, C_IF, Here(code))
+		&& Emit(code, I_BRANCH0, 0);
+}
+
+static _Bool Else(Stack code, Stack control)
+{
+	struct control c;
+	if (!PopControl(control, MASK(C_IF), &c)) return false;
+
+	const size_t at = Here(code);
+	if (!Emit(code, I_BRANCH, 0)) return false;
+	Resolve(code, c.at);
+	return PushControl(control, C_ELSE, at);
+}
+
+static _Bool Then(Stack code, Stack control)
+{
+	struct control c;
+	if (!PopControl(control, MASK(C_IF)|MASK(C_ELSE), &c)) return false;
+	Resolve(code, c.at);
+	return true;
+}
+
+static _Bool Do(Stack code, Stack control)
+{
+	return PushControl(control, C_DO, Here(code))
+		&& Emit(code, I_DO, 0);
+}
+
+static _Bool QDo(Stack code, Stack control)
+{
+	return PushControl(control, C_DO, Here(code))
+		&& Emit(code, I_QDO, 0);
+}
+
+static _Bool CloseLoop(Stack code, Stack control, enum instruction_type type)
+{
+	struct control c;
+	if (!PopControl(control, MASK(C_DO), &c)) return false;
+	if (!EmitBack(code, type, c.at + 1)) return false;
+	/* ?DO skips past the loop when there is nothing to do. */
+	if (I_QDO == At(code, c.at)->type)
+		Resolve(code, c.at);
+	return true;
+}
+
+static _Bool Loop(Stack code, Stack control)
+{ return CloseLoop(code, control, I_LOOP); }
+
+static _Bool PlusLoop(Stack code, Stack control)
+{ return CloseLoop(code, control, I_PLUSLOOP); }
+
+static _Bool Unloop(Stack code, Stack control)
+{
+	return LoopDepth(control, false) >= 1 && Emit(code, I_UNLOOP, 0);
+}
+
+static _Bool I(Stack code, Stack control)
+{
+	return LoopDepth(control, true) >= 1 && Emit(code, I_INDEX, 0);
+}
+
+static _Bool J(Stack code, Stack control)
+{
+	return LoopDepth(control, true) >= 2 && Emit(code, I_INDEX, 1);
+}
+
+/* The body runs from I_PARDO to an I_EXIT, followed by the combining word,
+   which CompileWord resolves the I_PARDO past. */
+static _Bool ParDo(Stack code, Stack control)
+{
+	return PushControl(control, C_PARDO, Here(code))
+		&& Emit(code, I_PARDO, 0);
+}
+
+static _Bool ParLoop(Stack code, Stack control)
+{
+	struct control c;
+	return PopControl(control, MASK(C_PARDO), &c)
+		&& Emit(code, I_EXIT, 0)
+		&& PushControl(control, C_COMBINE, c.at);
+}
+
+static _Bool Begin(Stack code, Stack control)
+{
+	return PushControl(control, C_BEGIN, Here(code));
+}
+
+static _Bool Until(Stack code, Stack control)
+{
+	struct control c;
+	return PopControl(control, MASK(C_BEGIN), &c)
+		&& EmitBack(code, I_BRANCH0, c.at);
+}
+
+static _Bool Again(Stack code, Stack control)
+{
+	struct control c;
+	return PopControl(control, MASK(C_BEGIN), &c)
+		&& EmitBack(code, I_BRANCH, c.at);
+}
+
+static _Bool While(Stack code, Stack control)
+{
+	struct control c;
+	/* Peek: the BEGIN stays, to be resolved by REPEAT. */
+	if (!PopControl(control, MASK(C_BEGIN), &c)) return false;
+	return PushControl(control, C_BEGIN, c.at)
+		&& PushControl(control, C_WHILE, Here(code))
+		&& Emit(code, I_BRANCH0, 0);
+}
+
+static _Bool Repeat(Stack code, Stack control)
+{
+	struct control w, b;
+	if (!PopControl(control, MASK(C_WHILE), &w)) return false;
+	if (!PopControl(control, MASK(C_BEGIN), &b)) return false;
+	if (!EmitBack(code, I_BRANCH, b.at)) return false;
+	Resolve(code, w.at);
+	return true;
+}
+
+static _Bool Exit(Stack code, Stack control)
+{
+	unsigned long n = LoopDepth(control, false);
+	/* There is no leaving a PAR-DO's body but by its end. */
+	if (n != LoopDepth(control, true)) return false;
+	/* Loop parameters must be off the return stack before returning, as
+	   must locals, beneath them. */
+	for (; n; --n)
+		if (!Emit(code, I_UNLOOP, 0)) return false;
+	const long frame = FrameSize(code, control);
+	if (frame && !Emit(code, I_ENDLOCALS, frame)) return false;
+	return Emit(code, I_EXIT, 0);
+}
+
+static _Bool To(Stack code, Stack control)
+{
+	/* A PAR-DO's body only has copies of the locals to change. */
+	return FrameSize(code, control)
+		&& LoopDepth(control, false) == LoopDepth(control, true)
+		&& PushControl(control, C_TO, Here(code));
+}
+
+static const struct {
+	const char* name;
+	_Bool (*compile)(Stack code, Stack control);
+} ControlWords[] = {
+	{"IF", If}, {"ELSE", Else}, {"THEN", Then},
+	{"DO", Do}, {"?DO", QDo}, {"LOOP", Loop}, {"+LOOP", PlusLoop},
+	{"UNLOOP", Unloop}, {"I", I}, {"J", J},
+	{"BEGIN", Begin}, {"UNTIL", Until}, {"AGAIN", Again},
+	{"WHILE", While}, {"REPEAT", Repeat},
+	{"EXIT", Exit}, {"TO", To},
+	{"PAR-DO", ParDo}, {"PAR-LOOP", ParLoop},
+};
+#define N_CONTROL_WORDS (sizeof(ControlWords)/sizeof(*ControlWords))
+
+/* Words defining a word for data, as ':' does one for code, and how many
+   bytes of the data space each allots. */
+static const struct {
+	const char* name;
+	long size;
+} DefiningWords[] = {
+	{"CREATE", 0}, {"VARIABLE", sizeof(long)},
+};
+#define N_DEFINING_WORDS (sizeof(DefiningWords)/sizeof(*DefiningWords))
+
+/* Returns the index of `word` in DefiningWords, or -1. */
+static int Defining(const char* word)
+{
+	for (size_t i = 0; i < N_DEFINING_WORDS; ++i)
+		if (!strcmp(word, DefiningWords[i].name)) return (int)i;
+	return -1;
+}
+
+/* Returns true if `def` is worth copying into its callers, and can be. */
+/* Those leaving it other than by its end, and PAR-DOs, whose bodies do,
+   can't; nor can words whose code changes after they're compiled. As a
+   redefinition doesn't change callers compiled before it, copies stay as
+   up to date as calls would. */
+static _Bool Inlinable(const struct Definition* def)
+{
+	if (def->created || def->length - 1 > INLINE_SIZE) return false;
+	for (unsigned long i = 0; i + 1 < def->length; ++i)
+		switch (def->code[i].type) {
+		case I_EXIT:
+		case I_PARDO:
+		case I_CREATE:
+			return false;
+		default:
+			break; }
+	return true;
+}
+
+/* Copies the body of `def` to the end of `code`, sharing what it holds. */
+static _Bool Inline(Stack code, const struct Definition* def)
+{
+	/* Branches are relative, so the body works as well anywhere; those to
+	   its I_EXIT land on what follows. */
+	for (unsigned long i = 0; i + 1 < def->length; ++i) {
+		if (!StackPush(code, &def->code[i])) return false;
+		InstructionRetain(At(code, Here(code) - 1)); }
+	return true;
+}
+
+/* Compiles a single word; returns false after reporting an error. */
+/* `control` and `locals`, the names of the definition's locals, are NULL
+   outside of colon definitions. */
+static _Bool CompileWord(struct State state, Stack code, Stack control,
+                         Stack locals, const char* word,
+                         void(*handleError)(struct Output*, struct error))
+{
+	/* PAR-LOOP must be followed by the word combining results, and TO by
+	   the name of a local. */
+	const _Bool combining = Within(control, C_COMBINE);
+	const _Bool to        = Within(control, C_TO);
+
+	/* Locals are found first, and read or set in place: the frame is
+	   beneath the parameters of any loops since. */
+	const long local = combining ? -1 : Local(locals, word);
+	if (local >= 0) {
+		struct control c;
+		if (to) PopControl(control, MASK(C_TO), &c);
+		const long depth = FrameSize(code, control) - 1 - local
+		                   + 2 * (long)LoopDepth(control, true);
+		return Emit(code, to ? I_TO : I_LOCAL, depth); }
+	if (to) {
+		Report(state, handleError, E_BADLOCALS, word);
+		return false; }
+
+	for (size_t i = 0; i < N_CONTROL_WORDS; ++i)
+		if (!strcmp(word, ControlWords[i].name)) {
+			if (!control) {
+				Report(state, handleError, E_COMPILEONLY, word);
+				return false; }
+			if (!combining && ControlWords[i].compile(code, control))
+				return true;
+			Report(state, handleError, E_UNBALANCED, word);
+			return false; }
+
+	ForthWord fw;
+	if (!Lookup(state, word, &fw)) {
+		Report(state, handleError, IsCompileOnly(word) ? E_COMPILEONLY
+		                  : Defining(word) >= 0 && control ? E_INTERPRETONLY
+		                  : E_NOTINDICT, word);
+		return false; }
+
+	/* The word combining PAR-DO's results must be called. */
+	if (F_COMPILED == fw.type && !combining && Inlinable(fw.data.compiled))
+		return Inline(code, fw.data.compiled);
+
+	Instruction in;
+	in.type = I_CALL;
+	in.data.word = fw;
+	if (!StackPush(code, &in)) return false;
+	if (F_COMPILED == fw.type)
+		DefinitionRetain(fw.data.compiled);
+	if (combining) {
+		struct control c;
+		PopControl(control, MASK(C_COMBINE), &c);
+		Resolve(code, c.at); }
+	return true;
+}
+
+/* Makes `*d` a share of a string equal to `text` that `code` already
+   holds, or a new one; a literal is only kept once in a definition. */
+static _Bool Literal(Stack code, const char* text, ForthDatum* d)
+{
+	const size_t length = strlen(text);
+	if (length > STRING_SHORT)
+		for (size_t i = 0; i < StackDepth(code); ++i) {
+			const Instruction* in = At(code, i);
+			if (I_STRING == in->type
+			    && length == StringLength(in->data.String)
+			    && !memcmp(text, StringText(&in->data.String), length)) {
+				*d = in->data.String;
+				StringRetain(*d);
+				return true; }}
+	return StringNew(d, text, length);
+}
+
+/* Compiles an object other than O_EOF, copying any string it keeps. */
+/* Returns false after reporting an error. */
+static _Bool CompileObject(struct State state, Stack code, Stack control,
+                           Stack locals, enum object_type t, Object* o,
+                           void(*handleError)(struct Output*, struct error))
+{
+	_Bool ok = true;
+	if (O_WORD != t && O_ERROR != t && Within(control, C_COMBINE)) {
+		Report(state, handleError, E_UNBALANCED, "PAR-LOOP");
+		return false; }
+	if (O_WORD != t && O_ERROR != t && Within(control, C_TO)) {
+		Report(state, handleError, E_BADLOCALS, "TO");
+		return false; }
+	switch (t) {
+	case O_WORD:
+		ok = CompileWord(state, code, control, locals, o->word, handleError);
+		break;
+	case O_INTEGRAL:
+		ok = Emit(code, I_INT, o->integral);
+		break;
+	case O_FRACTIONAL: {
+		Instruction in = {.data.Float = o->fractional, .type = I_FLOAT};
+		ok = StackPush(code, &in);
+	} break;
+	case O_STRING: {
+		Instruction in;
+		in.type = I_STRING;
+		if (!Literal(code, o->string, &in.data.String)) {
+			OutputError(state.output,
+			            "ERROR: Out of memory compiling a string.\n");
+			ok = false; }
+		else if (!(ok = StackPush(code, &in)))
+			StringRelease(in.data.String);
+	} break;
+	case O_ERROR:
+		if (handleError) handleError(state.output, o->error);
+		ok = false;
+		break;
+	default:
+		OutputError(state.output,
+		            "BUG: Bad value passed to the compiler from "
+		            "function pointer getobj.\n");
+		break; }
+	return ok;
+}
+
+/* Copies compiled code into a new definition, terminating it. */
+/* On failure the code is released, and NULL is returned. */
+static struct Definition* Finish(Stack code)
+{
+	struct Definition* def = NULL;
+	if (Emit(code, I_EXIT, 0) && (def = DefinitionNew(StackDepth(code))))
+		memcpy(def->code, StackPeek(code),
+		       StackDepth(code) * sizeof(Instruction));
+	else
+		for (size_t i = 0; i < StackDepth(code); ++i)
+			InstructionRelease(At(code, i));
+	return def;
+}
+
+/* Adds `def` to the namespace under `key`, taking both. */
+/* Returns the definition, borrowed from the namespace, setting `*name` to
+   the key it's stored under, or NULL on failed allocation. */
+static struct Definition* Bind(struct State state, char* key,
+                               struct Definition* def, const char** name)
+{
+	ForthWord fw = {.data.compiled = def, .type = F_COMPILED};
+	/* Redefinition: callers compiled earlier keep the old body. */
+	if (!DictReplace(state.namespace, &key, &fw)) {
+		DefinitionRelease(def);
+		free(key);
+		return NULL; }
+	*name = key;
+	return def;
+}
+
+/* Compiles the declaration of locals following a `{:`, up to its `:}`:
+   in `{: a b | c -- d :}`, a and b are taken from the stack, b from its
+   top, c starts out as 0, and d only documents what is returned. */
+/* Returns false after reporting an error, or on encountering the end of
+   the file, with `*t` and `*o` the last object read. */
+static _Bool Declare(struct State state, Reader getobj, unsigned base,
+                     Stack code, Stack control, Stack locals,
+                     void(*handleError)(struct Output*, struct error),
+                     enum object_type* t, Object* o)
+{
+	/* One frame, outside of any control structure, so that where it is on
+	   the return stack is known wherever it's used. */
+	if (!StackIsEmpty(control) || !StackIsEmpty(locals)) {
+		Report(state, handleError, E_BADLOCALS, "{:");
+		return false; }
+
+	enum { ARGUMENTS, VALUES, RESULTS } part = ARGUMENTS;
+	for (;;) {
+		*t = READ(getobj, o, base);
+		if (O_EOF == *t) return false;
+		if (O_WORD != *t || !strcmp(o->word, ";")) {
+			if (O_ERROR == *t && handleError)
+				handleError(state.output, o->error);
+			else Report(state, handleError, E_BADLOCALS,
+			            O_WORD == *t ? o->word :
+			            O_STRING == *t ? o->string : NULL);
+			return false; }
+		if (!strcmp(o->word, ":}")) break;
+		if (!strcmp(o->word, "|") && ARGUMENTS == part) part = VALUES;
+		else if (!strcmp(o->word, "--") && RESULTS != part) part = RESULTS;
+		else if (RESULTS != part) {
+			char* name = pstrdup(o->word);
+			if (!name || !StackPush(locals, &name)) {
+				free(name);
+				OutputError(state.output,
+				            "ERROR: Out of memory declaring `%s`.\n", o->word);
+				return false; }
+			if (VALUES == part && !Emit(code, I_INT, 0)) return false; }}
+
+	if (StackIsEmpty(locals)) return true;
+	return PushControl(control, C_LOCALS, Here(code))
+		&& Emit(code, I_LOCALS, (long)StackDepth(locals));
+}
+
+/* Compiles a definition following its ':', adding it to the namespace,
+   reading numbers in `base`. */
+/* Returns the definition, borrowed from the namespace, or NULL on error;
+   `*name` is then the key it's stored under. `*more` is cleared on
+   encountering the end of the file. */
+static struct Definition* Define(struct State state,
+                                 Reader getobj,
+                                 void(*handleError)(struct Output*,
+                                                    struct error),
+                                 unsigned base,
+                                 const char** name, _Bool* more)
+{
+	_Bool failed = false; /* Once set, input is skipped up to the ';'. */
+	char* key    = NULL;
+	Object o;
+
+	*more = true;
+
+	/* The name is the very next token. */
+	switch (READ(getobj, &o, base)) {
+	case O_WORD:
+		if (!(key = pstrdup(o.word))) {
+			OutputError(state.output,
+			            "ERROR: Out of memory compiling `%s`.\n", o.word);
+			failed = true; }
+		break;
+	case O_STRING:
+		Report(state, handleError, E_BADNAME, o.string);
+		failed = true;
+		break;
+	case O_ERROR:
+		if (handleError) handleError(state.output, o.error);
+		failed = true;
+		break;
+	case O_EOF:
+		Report(state, handleError, E_UNTERMINATED_DEFINITION, NULL);
+		*more = false;
+		return NULL;
+	default:
+		Report(state, handleError, E_BADNAME, NULL);
+		failed = true;
+		break; }
+	DEBUG_PRINTF("Define: Compiling `%s`.\n", key);
+
+	Stack code;    PALLOCA(code, StackSize());
+	Stack control; PALLOCA(control, StackSize());
+	Stack locals;  PALLOCA(locals, StackSize());
+	code    = StackNew(code, sizeof(Instruction), NULL);
+	control = StackNew(control, sizeof(struct control), NULL);
+	locals  = StackNew(locals, sizeof(char*), FreeName);
+	if (!code || !control || !locals) {
+		OutputError(state.output,
+		            "ERROR: Out of memory compiling a definition.\n");
+		free(key);
+		if (code)    StackDelete(code);
+		if (control) StackDelete(control);
+		if (locals)  StackDelete(locals);
+		return NULL; }
+
+	for (;;) {
+		enum object_type t = READ(getobj, &o, base);
+		if (!failed && O_WORD == t && !strcmp(o.word, "{:")) {
+			if (Declare(state, getobj, base, code, control, locals, handleError,
+			            &t, &o)) continue;
+			failed = true; }
+		if (O_EOF == t) {
+			Report(state, handleError, E_UNTERMINATED_DEFINITION, key);
+			failed = true;
+			*more = false;
+			break; }
+		if (O_WORD == t && !strcmp(o.word, ";")) break;
+
+		if (!failed)
+			failed = !CompileObject(state, code, control, locals, t, &o,
+			                        handleError); }
+
+	/* The frame of locals is discarded on the way out. */
+	const long frame = FrameSize(code, control);
+	struct control c;
+	if (!failed && 1 == StackDepth(control) &&
+	    PopControl(control, MASK(C_LOCALS), &c))
+		failed = !Emit(code, I_ENDLOCALS, frame);
+
+	if (!failed && !StackIsEmpty(control)) {
+		Report(state, handleError, E_UNBALANCED, key);
+		failed = true; }
+
+	struct Definition* def = NULL;
+	if (failed)
+		for (size_t i = 0; i < StackDepth(code); ++i)
+			InstructionRelease(At(code, i));
+	else if ((def = Finish(code))) {
+		def = Bind(state, key, def, name);
+		key = NULL; }
+	free(key);
+
+	StackDelete(locals);
+	StackDelete(control);
+	StackDelete(code);
+	return def;
+}
+
+/* Defines the word named after a defining word as one pushing an address,
+   which is 0 until an I_CREATE sets it. Numbers are read in `base`. */
+/* Returns the definition, borrowed from the namespace, or NULL on error;
+   `*name` is then the key it's stored under. `*more` is cleared on
+   encountering the end of the file. */
+static struct Definition* Created(struct State state,
+                                  Reader getobj,
+                                  void(*handleError)(struct Output*,
+                                                     struct error),
+                                  unsigned base,
+                                  const char** name, _Bool* more)
+{
+	Object o;
+	*more = true;
+	switch (READ(getobj, &o, base)) {
+	case O_WORD:
+		break;
+	case O_STRING:
+		Report(state, handleError, E_BADNAME, o.string);
+		return NULL;
+	case O_ERROR:
+		if (handleError) handleError(state.output, o.error);
+		return NULL;
+	case O_EOF:
+		*more = false;
+		// fallthrough
+	default:
+		Report(state, handleError, E_BADNAME, NULL);
+		return NULL; }
+
+	char* key = pstrdup(o.word);
+	struct Definition* def = key ? DefinitionNew(2) : NULL;
+	if (!def) {
+		OutputError(state.output,
+		            "ERROR: Out of memory defining `%s`.\n", o.word);
+		free(key);
+		return NULL; }
+	def->code[0].type     = I_INT;
+	def->code[0].data.Int = 0;
+	def->code[1].type     = I_EXIT;
+	def->code[1].data.Int = 0;
+	def->created          = true;
+	return Bind(state, key, def, name);
+}
+
+/* Makes `in` the I_CREATE for `def`, which it doesn't hold. */
+static void Create(Instruction* in, struct Definition* def)
+{
+	in->type = I_CREATE;
+	in->data.word.data.compiled = def;
+	in->data.word.type = F_COMPILED;
+}
+
+/* Records a definition CompileProgram has made in `defined`. */
+static _Bool Record(Stack defined, struct Definition* def, const char* name)
+{
+	struct NamedDefinition nd = {pstrdup(name), def};
+	if (!nd.name || !StackPush(defined, &nd)) {
+		free(nd.name);
+		return false; }
+	DefinitionRetain(def);
+	return true;
+}
+
+/********** PUBLIC **********/
+_Bool IsCompileOnly(const char* word)
+{
+	if (!strcmp(word, ";") || !strcmp(word, "{:")) return true;
+	for (size_t i = 0; i < N_CONTROL_WORDS; ++i)
+		if (!strcmp(word, ControlWords[i].name)) return true;
+	return false;
+}
+
+_Bool IsDefining(const char* word)
+{
+	return Defining(word) >= 0;
+}
+
+/* Returns false on encountering the end of the file. */
+_Bool CompileCreate(struct State state,
+                    Reader getobj,
+                    // handleError can be NULL
+                    void(*handleError)(struct Output*, struct error),
+                    const char* word)
+{
+	cassert(state.namespace);
+	cassert(getobj.read);
+	cassert(IsDefining(word));
+
+	/* Read before the name, which may take the place of `word`. */
+	const long size = DefiningWords[Defining(word)].size;
+	const char* name;
+	_Bool more;
+	struct Definition* def = Created(state, getobj, handleError,
+	                                 DataRadix(state.data), &name, &more);
+
+	/* Run what a program would have compiled. */
+	Instruction code[3];
+	code[0].type     = I_INT;
+	code[0].data.Int = size;
+	Create(&code[1], def);
+	code[2].type     = I_EXIT;
+	if (def) ExecuteCode(state, code);
+	return more;
+}
+
+/* Returns false on encountering the end of the file. */
+_Bool CompileDefinition(struct State state,
+                        Reader getobj,
+                        // handleError can be NULL
+                        void(*handleError)(struct Output*, struct error))
+{
+	cassert(state.namespace);
+	cassert(getobj.read);
+
+	const char* name;
+	_Bool more;
+	Define(state, getobj, handleError, DataRadix(state.data), &name, &more);
+	return more;
+}
+
+struct Definition* CompileProgram(struct State state,
+                                  Reader getobj,
+                                  // handleError can be NULL
+                                  void(*handleError)(struct Output*,
+                                                     struct error),
+                                  Stack defined, _Bool* clean)
+{
+	cassert(state.namespace);
+	cassert(getobj.read);
+	cassert(defined);
+	cassert(clean);
+
+	*clean = true;
+
+	Stack code; PALLOCA(code, StackSize());
+	code = StackNew(code, sizeof(Instruction), NULL);
+	if (!code) return NULL;
+
+	/* The program only runs once it's all compiled, so BASE can't change
+	   as it's read: HEX and DECIMAL, compiled as ever, change it here too.
+	   Nothing else does, such as `16 BASE !` or HEX within a word, which
+	   go unseen until the program runs. */
+	unsigned base = DataRadix(state.data);
+
+	Object o;
+	enum object_type t;
+	_Bool more = true;
+	while (more && O_EOF != (t = READ(getobj, &o, base))) {
+		if (O_WORD == t && !strcmp(o.word, ":")
+		    && !Lookup(state, o.word, NULL)) {
+			const char* name;
+			struct Definition* def = Define(state, getobj, handleError,
+			                                base, &name, &more);
+			if (!def || !Record(defined, def, name)) *clean = false;
+			continue; }
+		if (O_WORD == t && IsDefining(o.word)
+		    && !Lookup(state, o.word, NULL)) {
+			const long size = DefiningWords[Defining(o.word)].size;
+			const char* name;
+			struct Definition* def = Created(state, getobj, handleError,
+			                                 base, &name, &more);
+			Instruction in;
+			if (def) Create(&in, def);
+			if (!def || !Record(defined, def, name) ||
+			    !Emit(code, I_INT, size) || !StackPush(code, &in)) {
+				*clean = false;
+				continue; }
+			DefinitionRetain(def);
+			continue; }
+
+		if (O_WORD == t && !strcmp(o.word, "HEX"))     base = 16;
+		if (O_WORD == t && !strcmp(o.word, "DECIMAL")) base = 10;
+		if (!CompileObject(state, code, NULL, NULL, t, &o, handleError))
+			*clean = false; }
+
+	struct Definition* program = Finish(code);
+	StackDelete(code);
+	return program;
+}
@@ -0,0 +1,48 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include "ForthTypes.h"
+#include "Eval.h"
+
+/* Returns true if `word` only has meaning inside a colon definition. */
+_Bool IsCompileOnly(const char* word);
+
+/* Returns true if `word` defines a word for data, as CREATE does. */
+_Bool IsDefining(const char* word);
+
+/* Defines the word named after a defining word `word` read by `getobj`,
+   and allots its data. */
+/* Returns false on encountering the end of the file. */
+_Bool CompileCreate(struct State state,
+                    Reader getobj,
+                    // handleError can be NULL
+                    void(*handleError)(struct Output*, struct error),
+                    const char* word);
+
+/* Compiles the colon definition following a ':' read by `getobj`,
+   adding it to `state.namespace` once its closing ';' is reached. */
+/* Returns false on encountering the end of the file. */
+_Bool CompileDefinition(struct State state,
+                        Reader getobj,
+                        // handleError can be NULL
+                        void(*handleError)(struct Output*, struct error));
+
+/* Compiles everything `getobj` reads into a definition that, when executed,
+   does what interpreting the input would. Colon definitions, and those of
+   defining words, are added to `state.namespace` as they are met, and
+   recorded, in order, in `defined`: a Stack of struct NamedDefinition,
+   whose elements the caller then owns. */
+/* Numbers are read in BASE as it is before the program runs, and as HEX
+   and DECIMAL, outside of definitions, then set it; other changes to BASE
+   only take effect as the program runs, and so don't change how it's
+   read. */
+/* Returns NULL on failed allocation. `*clean` is cleared if any error was
+   reported, in which case the offending tokens are left out. */
+struct Definition* CompileProgram(struct State state,
+                                  Reader getobj,
+                                  // handleError can be NULL
+                                  void(*handleError)(struct Output*,
+                                                     struct error),
+                                  Stack defined, _Bool* clean);
+
+#endif /* COMPILE_H */
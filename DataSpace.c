@@ -0,0 +1,221 @@
+#define _GNU_SOURCE // memfd_create
+#include <stdlib.h>
+#include <string.h> // memset, memcpy
+#include <stdint.h> // uintptr_t
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h> // ftruncate, close, sysconf
+
+#include "DataSpace.h"
+#include "Assert.h"
+
+/* Address space reserved for each data space; only what is allotted is
+   ever committed. */
+#define DATA_RESERVE (1UL << 30)
+/* Memory is committed this much at a time, or a huge page at a time. */
+#define COMMIT_SIZE  (64 * 1024)
+#define HUGE_SIZE    (2 * 1024 * 1024)
+
+struct DataSpace {
+	char* base;
+	char* mapping;  /* Where the reservation starts, before `base`. */
+	size_t mapped;
+	_Atomic size_t here;
+	size_t committed;
+	size_t step;    /* How much to commit at a time. */
+	_Bool hugePages;
+	pthread_mutex_t allotting;
+
+	/// Of frozen data spaces: the file their allotted bytes are kept in.
+	int fd;         /* -1 if there is none. */
+	size_t shared;  /* How much of it, from `base`, is mapped. */
+};
+
+/********** PRIVATE **********/
+/* Commits up to `end`. */
+static _Bool Commit(DataSpace d, size_t end)
+{
+	if (end <= d->committed) return true;
+	size_t to = (end + d->step - 1) / d->step * d->step;
+	if (to > DATA_RESERVE) to = DATA_RESERVE;
+	if (mprotect(d->base + d->committed, to - d->committed,
+	             PROT_READ | PROT_WRITE)) return false;
+	d->committed = to;
+	return true;
+}
+
+/********** PUBLIC **********/
+size_t DataSpaceSize(void)
+{
+	return sizeof(struct DataSpace);
+}
+
+DataSpace DataSpaceNew(void* memory, _Bool hugePages)
+{
+	cassert(memory);
+
+	DataSpace d = memory;
+	d->here      = 0;
+	d->committed = 0;
+	d->fd        = -1;
+	d->shared    = 0;
+	d->hugePages = hugePages;
+	d->step      = hugePages ? HUGE_SIZE : COMMIT_SIZE;
+
+	/* Huge pages have to be aligned to their size. */
+	d->mapped  = DATA_RESERVE + (hugePages ? HUGE_SIZE : 0);
+	d->mapping = mmap(NULL, d->mapped, PROT_NONE,
+	                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (MAP_FAILED == d->mapping) return NULL;
+	d->base = d->mapping;
+	if (hugePages) {
+		d->base += (HUGE_SIZE - (uintptr_t)d->mapping % HUGE_SIZE) % HUGE_SIZE;
+#ifdef MADV_HUGEPAGE
+		madvise(d->base, DATA_RESERVE, MADV_HUGEPAGE);
+#endif
+	}
+	if (pthread_mutex_init(&d->allotting, NULL)) {
+		munmap(d->mapping, d->mapped);
+		return NULL; }
+	const long base = 10;
+	if (!DataAppend(d, &base, sizeof(base))) {
+		DataSpaceDelete(d);
+		return NULL; }
+	return d;
+}
+
+DataSpace DataSpaceFreeze(void* memory, const DataSpace from)
+{
+	cassert(from);
+
+	DataSpace d = DataSpaceNew(memory, from->hugePages);
+	if (!d) return NULL;
+	const size_t here = from->here;
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t size = (here + page - 1) / page * page;
+#ifdef MFD_CLOEXEC
+	/* Without a file to share, clones copy what was allotted instead. */
+	const int fd = memfd_create("forth-data", MFD_CLOEXEC);
+	if (fd < 0) goto DataSpaceFreeze_Copy;
+	if (ftruncate(fd, (off_t)size) ||
+	    MAP_FAILED == mmap(d->base, size, PROT_READ | PROT_WRITE,
+	                       MAP_SHARED | MAP_FIXED, fd, 0)) {
+		close(fd);
+		goto DataSpaceFreeze_Copy; }
+	memcpy(d->base, from->base, here);
+	d->here   = here;
+	d->fd     = fd;
+	d->shared = size;
+	if (d->committed < size) d->committed = size;
+	return d;
+
+DataSpaceFreeze_Copy:
+	/* The mapping may have been replaced, if not by the file. */
+	if (MAP_FAILED == mmap(d->base, size, PROT_READ | PROT_WRITE,
+	                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0)) {
+		DataSpaceDelete(d);
+		return NULL; }
+	if (d->committed < size) d->committed = size;
+#endif
+	memcpy(d->base, from->base, DATA_START);
+	if (!DataAppend(d, from->base + DATA_START, here - DATA_START)) {
+		DataSpaceDelete(d);
+		return NULL; }
+	return d;
+}
+
+DataSpace DataSpaceClone(void* memory, const DataSpace from)
+{
+	cassert(from);
+
+	DataSpace d = DataSpaceNew(memory, from->hugePages);
+	if (!d) return NULL;
+	const size_t here = from->here;
+	/* A frozen data space's pages are only copied once they're written. */
+	if (from->fd >= 0) {
+		if (MAP_FAILED == mmap(d->base, from->shared, PROT_READ | PROT_WRITE,
+		                       MAP_PRIVATE | MAP_FIXED, from->fd, 0)) {
+			DataSpaceDelete(d);
+			return NULL; }
+		d->here = here;
+		if (d->committed < from->shared) d->committed = from->shared;
+		return d; }
+	memcpy(d->base, from->base, DATA_START);
+	if (!DataAppend(d, from->base + DATA_START, here - DATA_START)) {
+		DataSpaceDelete(d);
+		return NULL; }
+	return d;
+}
+
+long DataHere(const DataSpace d)
+{
+	cassert(d);
+	return (long)d->here;
+}
+
+_Bool DataAllot(DataSpace d, long n)
+{
+	long at;
+	return DataCreate(d, n, &at);
+}
+
+_Bool DataCreate(DataSpace d, long n, long* at)
+{
+	cassert(d);
+	cassert(at);
+
+	_Bool ok = false;
+	pthread_mutex_lock(&d->allotting);
+	const size_t here = d->here;
+	if (n < 0 ? (size_t)-(unsigned long)n > here - DATA_START
+	          : (size_t)n > DATA_RESERVE - here)
+		goto DataCreate_Unlock;
+	const size_t end = here + (size_t)n;
+	if (n > 0) {
+		if (!Commit(d, end)) goto DataCreate_Unlock;
+		memset(d->base + here, 0, (size_t)n); }
+	*at = (long)here;
+	d->here = end;
+	ok = true;
+
+	/* ERROR BLOCK */
+DataCreate_Unlock:
+	pthread_mutex_unlock(&d->allotting);
+	return ok;
+}
+
+_Bool DataAppend(DataSpace d, const void* bytes, size_t n)
+{
+	cassert(bytes || !n);
+
+	long at;
+	if (n > DATA_RESERVE || !DataCreate(d, (long)n, &at)) return false;
+	if (n) memcpy(d->base + at, bytes, n);
+	return true;
+}
+
+void* DataAt(const DataSpace d, long at, size_t n)
+{
+	cassert(d);
+	const size_t here = d->here;
+	if (at < 0 || (size_t)at > here || n > here - (size_t)at) return NULL;
+	return d->base + at;
+}
+
+unsigned DataRadix(const DataSpace d)
+{
+	if (!d) return 10;
+	long base;
+	memcpy(&base, d->base + DATA_BASE, sizeof(base));
+	return base >= 2 && base <= 36 ? (unsigned)base : 10;
+}
+
+void DataSpaceDelete(DataSpace d)
+{
+	cassert(d);
+	pthread_mutex_destroy(&d->allotting);
+	munmap(d->mapping, d->mapped);
+	if (d->fd >= 0) close(d->fd);
+}
@@ -0,0 +1,57 @@
+#ifndef DATA_SPACE_H
+#define DATA_SPACE_H
+#include <stddef.h>
+
+/* The memory HERE, ALLOT, @ and ! work on: one contiguous range, reserved
+   up front and committed as it is allotted, so that it never moves. */
+/* Addresses are offsets from its start, which every access is checked
+   against, so they stay good in images and snapshots. */
+/* Allotting is safe from any thread. Accesses aren't synchronized, other
+   than in that they never fall outside of what has been allotted. */
+typedef struct DataSpace* DataSpace;
+
+/* The cells below DATA_START hold the variables the system keeps: BASE,
+   at DATA_BASE. Allotting starts after them. */
+#define DATA_BASE  0L
+#define DATA_START ((long)sizeof(long))
+
+size_t DataSpaceSize(void);
+
+/* Reserves the address space, asking for it to be backed by huge pages if
+   `hugePages`, with BASE set to 10. Returns NULL on failure. */
+DataSpace DataSpaceNew(void* memory, _Bool hugePages);
+
+/* As DataSpaceNew, with a copy of `from`'s variables, and of what it has
+   allotted. */
+DataSpace DataSpaceClone(void* memory, const DataSpace from);
+
+/* As DataSpaceClone, but for cloning from, as snapshots are: what has been
+   allotted is kept in a file where possible, which clones map, and so share
+   page by page, until they write to a page. It must not be changed. */
+DataSpace DataSpaceFreeze(void* memory, const DataSpace from);
+
+/* The address the next allotment starts at. */
+long DataHere(const DataSpace d);
+
+/* Moves HERE by `n` bytes, which can be negative. Allotted bytes are
+   zeroed. Returns false, leaving HERE as it was, if that would move it out
+   of the data space, or below DATA_START. */
+_Bool DataAllot(DataSpace d, long n);
+
+/* Allots `n` bytes, setting `*at` to their address. */
+_Bool DataCreate(DataSpace d, long n, long* at);
+
+/* Allots `n` bytes, and copies `bytes` there. */
+_Bool DataAppend(DataSpace d, const void* bytes, size_t n);
+
+/* The memory `n` bytes of which are at `at`, or NULL if they haven't all
+   been allotted. */
+void* DataAt(const DataSpace d, long at, size_t n);
+
+/* The radix numbers are read in: BASE of `d`, or 10 if `d` is NULL or
+   BASE isn't between 2 and 36. */
+unsigned DataRadix(const DataSpace d);
+
+void DataSpaceDelete(DataSpace d);
+
+#endif /* DATA_SPACE_H */
@@ -0,0 +1,86 @@
+#include <stdlib.h> // malloc, free
+#include <stdbool.h>
+
+#include "Definition.h"
+#include "ForthString.h"
+#include "ForthTypes.h"
+#include "Assert.h"
+
+struct Definition* DefinitionNew(unsigned long length)
+{
+	struct Definition* def = malloc(sizeof(struct Definition)
+	                                + length * sizeof(Instruction));
+	sassert(def); // STRICT
+	if (!def) return NULL;
+
+	def->refs    = 1;
+	def->length  = length;
+	def->created = false;
+	return def;
+}
+
+void DefinitionRetain(struct Definition* def)
+{
+	cassert(def);
+	if (DEFINITION_STATIC == def->refs) return;
+	++def->refs;
+}
+
+void DefinitionRelease(struct Definition* def)
+{
+	cassert(def);
+	if (DEFINITION_STATIC == def->refs) return;
+	if (--def->refs) return;
+
+	for (unsigned long i = 0; i < def->length; ++i)
+		InstructionRelease(&def->code[i]);
+	free(def);
+}
+
+void InstructionRetain(Instruction* in)
+{
+	cassert(in);
+	switch (in->type) {
+	case I_CALL:
+	case I_CREATE:
+		if (F_COMPILED == in->data.word.type)
+			DefinitionRetain(in->data.word.data.compiled);
+		break;
+	case I_STRING:
+		StringRetain(in->data.String);
+		break;
+	default:
+		break; }
+}
+
+void InstructionRelease(Instruction* in)
+{
+	cassert(in);
+	switch (in->type) {
+	case I_CALL:
+	case I_CREATE:
+		if (F_COMPILED == in->data.word.type)
+			DefinitionRelease(in->data.word.data.compiled);
+		break;
+	case I_STRING:
+		StringRelease(in->data.String);
+		break;
+	default:
+		break; }
+}
+
+void ForthWordFree(void* fw)
+{
+	cassert(fw);
+	ForthWord* w = fw;
+	if (F_COMPILED == w->type)
+		DefinitionRelease(w->data.compiled);
+}
+
+void NamedDefinitionFree(void* nd)
+{
+	cassert(nd);
+	struct NamedDefinition* n = nd;
+	free(n->name);
+	DefinitionRelease(n->def);
+}
@@ -0,0 +1,38 @@
+#ifndef DEFINITION_H
+#define DEFINITION_H
+#include <stddef.h>
+#include "ForthTypes.h"
+
+/* A definition together with the name it was defined under. */
+struct NamedDefinition {
+	char* name;
+	struct Definition* def;
+};
+
+/* Value of `refs` for definitions that aren't owned by anything, such as those
+   mapped from an image. Retaining and releasing those does nothing. */
+#define DEFINITION_STATIC 0
+
+/* Allocates a definition with room for `length` instructions and one owner.
+   Returns NULL on allocation failure. */
+struct Definition* DefinitionNew(unsigned long length);
+
+/* Adds an owner to `def`. */
+void DefinitionRetain(struct Definition* def);
+
+/* Removes an owner from `def`, destroying it once no owners remain. */
+void DefinitionRelease(struct Definition* def);
+
+/* Adds an owner to whatever the instruction holds, for a copy of it. */
+void InstructionRetain(Instruction* in);
+
+/* Releases whatever the instruction owns: strings and called definitions. */
+void InstructionRelease(Instruction* in);
+
+/* Destructor for the ForthWord values of a namespace. */
+void ForthWordFree(void* fw);
+
+/* Destructor for struct NamedDefinition, as kept in a Stack. */
+void NamedDefinitionFree(void* nd);
+
+#endif /* DEFINITION_H */
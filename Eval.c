@@ -2,21 +2,29 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h> // strcmp, strcspn, strlen
 #include "Dict.h"
 #include "Stack.h"
 #include "ForthTypes.h"
 #include "Eval.h"
+#include "Compile.h"
+#include "Execute.h"
+#include "Session.h"
+#include "ForthString.h"
+#include "DataSpace.h"
+#include "Output.h"
 #include "Debug.h"
 
 /* Returns false on encountering the end of the file. */
-_Bool Eval(struct State state, enum object_type(*getobj)(Object*),
+_Bool Eval(struct State state, Reader getobj,
            // handleError can be NULL
-           void(*handleError)(struct error)) {
+           void(*handleError)(struct Output*, struct error)) {
 	assert(state.namespace);
 	assert(state.stack);
+	assert(state.returns);
 	// state.types can be NULL a user is attempting to forego type checking
 	// in order to improve speed. All other members of (struct State) cannot.
-	assert(getobj);
+	assert(getobj.read);
 
 #define TYPING_ON (1 << 8) /* Set the 8th bit. */
 #define TYPING_OFF (0)
@@ -30,17 +38,23 @@ _Bool Eval(struct State state, enum object_type(*getobj)(Object*),
 
 	/// Fairly ugly switch statement.
 	Object o;
-	switch (getobj(&o)|TypeState) {
+	switch (READ(getobj, &o, DataRadix(state.data))|TypeState) {
 	case O_WORD|TYPING_ON: // fallthrough
 	case O_WORD: {
 		DEBUG_PRINTF("Eval: Got an O_WORD from getobj: `%s`.\n", o.word);
 		ForthWord fw;
 		/* Try lookup: if lookup fails, break. */
-		/* TODO: Handle bad lookups: they mean an undefined symbol is used. */
-		if (!DictGet(state.namespace, &o.word, &fw)) {
-			if(handleError) handleError((struct error){.type=E_NOTINDICT,
-			                                           .bad_string=o.word});
-			goto freeWord; }
+		/* Words the compiler handles aren't in the namespace, so they're
+		   only looked for once a lookup has failed. */
+		if (!Lookup(state, o.word, &fw)) {
+			if (!strcmp(o.word, ":"))
+				return CompileDefinition(state, getobj, handleError);
+			if (IsDefining(o.word))
+				return CompileCreate(state, getobj, handleError, o.word);
+			if(handleError) handleError(state.output, (struct error){
+					.type = IsCompileOnly(o.word) ? E_COMPILEONLY : E_NOTINDICT,
+					.bad_string = o.word});
+			break; }
 		switch(fw.type) {
 		case F_BUILTIN:
 			DEBUG_PRINTF("Eval: Lookup with `%s` provided 0x%llx.\n",
@@ -48,16 +62,15 @@ _Bool Eval(struct State state, enum object_type(*getobj)(Object*),
 			/* Call builtin function, allowing it to mutate state. */
 			fw.data.builtin(state);
 			break;
-			/* TODO: add and manage additional forth word types. */
+		case F_COMPILED:
+			Execute(state, fw.data.compiled);
+			break;
 		default:
-			fprintf(stderr,
-			        "Bad value %d found for type in dict, "
-			        "for lookup string `%s`.",
-			        fw.type, o.word);
+			OutputError(state.output,
+			            "Bad value %d found for type in dict, "
+			            "for lookup string `%s`.",
+			            fw.type, o.word);
 			break; }
-		/* TODO: Allocate words in a static buffer, if sensible. */
-		freeWord:
-		free(o.word);
 	} break;
 	case O_INTEGRAL|TYPING_ON: {
 		enum datum_type t = T_INT;
@@ -69,28 +82,103 @@ _Bool Eval(struct State state, enum object_type(*getobj)(Object*),
 		fd.Int = o.integral;
 		StackPush(state.stack, &fd);
 	} break;
-	case O_STRING|TYPING_ON: {
-		enum datum_type t = T_STRING;
-		StackPush(state.types, &t); }
-		// fallthrough
+	case O_FRACTIONAL|TYPING_ON: // fallthrough
+	case O_FRACTIONAL:
+		DEBUG_PRINTF("Eval: Got an O_FRACTIONAL: `%g`.\n", o.fractional);
+		if (!state.floats || !StackPush(state.floats, &o.fractional))
+			OutputError(state.output, "ERROR: No room for `%g` on the "
+			                    "floating-point stack.\n", o.fractional);
+		break;
+	case O_STRING|TYPING_ON: // fallthrough
 	case O_STRING: {
 		DEBUG_PRINTF("Eval: Got an O_STRING: `%s`.\n", o.string);
+		/* The reader's copy won't last; the stack's has to. */
 		ForthDatum fd;
-		fd.String = o.string;
+		if (!StringNew(&fd, o.string, strlen(o.string))) {
+			OutputError(state.output, "ERROR: Out of memory.\n");
+			break; }
+		if (TypeState) {
+			enum datum_type t = T_STRING;
+			StackPush(state.types, &t); }
 		StackPush(state.stack, &fd);
 	} break;
 	case O_ERROR|TYPING_ON: // fallthrough
 	case O_ERROR:
-		if (handleError) handleError(o.error);
+		if (handleError) handleError(state.output, o.error);
 		break;
 	case O_EOF|TYPING_ON: // fallthrough
 	case O_EOF:
 		return false;
 		break;
 	default:
-		fprintf(stderr,
-		        "BUG: Bad value passed to Eval from "
-		        "function pointer getobj.\n");
+		OutputError(state.output,
+		            "BUG: Bad value passed to Eval from "
+		            "function pointer getobj.\n");
 		break; }
 	return true;
 }
+
+void ErrorHandler(struct Output* output, struct error e)
+{
+	/* Syntax errors point into the input: up to the end of it, not just of
+	   the token, or the line. */
+	switch(e.type) {
+	case E_UNTERMINATED_STRING:
+		OutputError(output, "SYNTAX ERROR: Unterminated string `%.*s`.\n",
+		            (int)strcspn(e.bad_string, "\n"), e.bad_string);
+		break;
+	case E_BADNUM:
+		OutputError(output, "SYNTAX ERROR: Bad numeric literal `%.*s`.\n",
+		            (int)strcspn(e.bad_string, " \t\n"), e.bad_string);
+		break;
+	case E_NOTINDICT:
+		if (e.bad_string)
+			OutputError(output, "ERROR: Failed lookup on `%s`.\n",
+			            e.bad_string);
+		else OutputError(output, "ERROR: Failed lookup.\n");
+		return;
+		break;
+	case E_LINETOOLONG:
+		if (e.bad_string)
+			OutputError(output, "ERROR: Token `%s` too long.\n", e.bad_string);
+		else OutputError(output, "ERROR: Token too long.\n");
+		break;
+	case E_UNTERMINATED_DEFINITION:
+		if (e.bad_string)
+			OutputError(output,
+			            "SYNTAX ERROR: Definition of `%s` lacks a `;`.\n",
+			            e.bad_string);
+		else OutputError(output, "SYNTAX ERROR: Definition lacks a name.\n");
+		break;
+	case E_BADNAME:
+		if (e.bad_string)
+			OutputError(output, "SYNTAX ERROR: Bad definition name `%s`.\n",
+			            e.bad_string);
+		else OutputError(output, "SYNTAX ERROR: Bad definition name.\n");
+		break;
+	case E_COMPILEONLY:
+		OutputError(output, "ERROR: `%s` is only usable inside a definition.\n",
+		            e.bad_string);
+		break;
+	case E_INTERPRETONLY:
+		OutputError(output, "ERROR: `%s` can't be used inside a definition.\n",
+		            e.bad_string);
+		break;
+	case E_UNBALANCED:
+		OutputError(output,
+		            "SYNTAX ERROR: Unbalanced control structure at `%s`.\n",
+		            e.bad_string);
+		break;
+	case E_BADLOCALS:
+		if (e.bad_string)
+			OutputError(output, "SYNTAX ERROR: Bad use of locals at `%s`.\n",
+			            e.bad_string);
+		else OutputError(output, "SYNTAX ERROR: Bad use of locals.\n");
+		break;
+	default:
+		OutputError(output,
+		            "Unhandled enum error_type instance or invalid value "
+		            "passed to ErrorHandler callback ostensibly by Eval: %d.\n",
+		            e.type);
+		break; }
+}
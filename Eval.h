@@ -3,8 +3,11 @@
 
 #include "ForthTypes.h"
 
-enum object_type { O_EOF, O_ERROR, O_WORD, O_INTEGRAL, O_STRING};
-enum  error_type{ E_BADNUM, E_NOTINDICT, E_LINETOOLONG, E_UNTERMINATED_STRING };
+enum object_type { O_EOF, O_ERROR, O_WORD, O_INTEGRAL, O_STRING,
+                   O_FRACTIONAL };
+enum  error_type{ E_BADNUM, E_NOTINDICT, E_LINETOOLONG, E_UNTERMINATED_STRING,
+                  E_UNTERMINATED_DEFINITION, E_BADNAME, E_COMPILEONLY,
+                  E_UNBALANCED, E_INTERPRETONLY, E_BADLOCALS };
 struct error {
 	const char* bad_string; // bad_string can be NULL if none is applicable.
 	enum error_type   type;
@@ -17,8 +20,25 @@ typedef union {
 	long      integral;
 } Object;
 
-_Bool Eval(struct State state, enum object_type(*getobj)(Object*),
+/* A source of objects, such as CreateGetObj makes of a FILE*, and
+   CreateStringObj of text in memory; see 'GetObj.h'. `read` is handed `ctx`,
+   which holds the state of that one reader, so any number can coexist,
+   and the base numbers are read in. */
+/* An object's word or string belongs to the reader, until the next READ;
+   anything kept longer is copied. */
+typedef struct {
+	enum object_type (*read)(void* ctx, Object* slot, unsigned base);
+	void* ctx;
+} Reader;
+
+/* Reads the next object from a Reader, with numbers in `base`. */
+#define READ(reader, slot, base) ((reader).read((reader).ctx, (slot), (base)))
+
+_Bool Eval(struct State state, Reader getobj,
            // handleError can be NULL
-           void(*handleError)(struct error));
+           void(*handleError)(struct Output*, struct error));
+
+/* Reports a description of `e` through `output`; see 'Output.h'. */
+void ErrorHandler(struct Output* output, struct error e);
 
 #endif // EVAL_H
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <limits.h> // CHAR_BIT, ULONG_MAX
+
+#include "Stack.h"
+#include "Assert.h"
+#include "ForthTypes.h"
+#include "ForthString.h"
+#include "DataSpace.h"
+#include "Output.h"
+#include "Execute.h"
+#include "Task.h"
+#include "Parallel.h"
+
+#include "Debug.h"
+
+/* Pointer to the topmost element of the return stack. */
+#define RTOP(s) ( (ReturnDatum*)StackPeek((s).returns) \
+                  + StackDepth((s).returns) - 1 )
+
+/********** PRIVATE: UTILITY FUNCTIONS **********/
+static inline _Bool Pop(struct State s, ForthDatum* d)
+{
+	if (s.types && !StackPop(s.types, NULL))
+		return false;
+	return StackPop(s.stack, d);
+}
+
+static inline _Bool Push(struct State s, enum datum_type type, ForthDatum d)
+{
+	if (s.types && !StackPush(s.types, &type))
+		return false;
+	if (!StackPush(s.stack, &d)) {
+		if (s.types) StackPop(s.types, NULL);
+		return false; }
+	return true;
+}
+
+static inline _Bool PushReturn(struct State s, ReturnDatum r)
+{
+	return StackPush(s.returns, &r);
+}
+
+/* Returns true if the topmost `n` items are numbers, as locals must be. */
+static inline _Bool Numbers(struct State s, long n)
+{
+	if (!s.types) return true;
+	const enum datum_type* types = StackPeek(s.types);
+	for (size_t i = StackDepth(s.types); n-- > 0 && i--; )
+		if (T_INT != types[i]) return false;
+	return true;
+}
+
+/* Returns true when stepping a loop index by `n` crosses its limit. */
+static inline _Bool Crossed(long index, long limit, long n)
+{
+	/* Done in unsigned arithmetic; the index is allowed to wrap around. */
+	const unsigned long before = (unsigned long)index - (unsigned long)limit;
+	const unsigned long after  = before + (unsigned long)n;
+	const unsigned long sign   = 1UL << (sizeof(long)*CHAR_BIT - 1);
+	return ((before ^ after) & (before ^ (unsigned long)n)) & sign;
+}
+
+/* Runs code from `ip` until it returns past `base`, returning NULL; or, if
+   `task`, until a builtin pauses the task or its budget runs out, returning
+   where to resume. */
+/* Runs nested in it, as builtins like EVALUATE start, draw on its budget,
+   through `state.fuel`; and, once that runs out, they are all given up on,
+   up to the outermost, which reports it. */
+static const Instruction* Run(struct State state, const Instruction* ip,
+                              size_t base, _Bool task)
+{
+	ForthDatum d;
+	/* Without a budget, this lasts longer than anything would. */
+	struct Fuel own = {state.budget ? state.budget : ULONG_MAX, false};
+	const _Bool outermost = !state.fuel;
+	if (outermost) state.fuel = &own;
+	/* Counted here, and handed back whenever another run may draw on it. */
+	unsigned long fuel = state.fuel->left;
+
+	for (;;) {
+		if (!fuel--) {
+			fuel = 0;
+			if (task && outermost && !own.exhausted) return ip;
+			goto Execute_OutOfFuel; }
+		switch (ip->type) {
+		case I_CALL:
+			if (F_BUILTIN == ip->data.word.type) {
+				state.fuel->left = fuel;
+				ip->data.word.data.builtin(state);
+				fuel = state.fuel->left;
+				if (task && TasksPausing(state.tasks))
+					return TasksBlocked(state.tasks) ? ip : ip + 1;
+				++ip;
+				break; }
+			if (!PushReturn(state, (ReturnDatum){.ip = ip + 1}))
+				goto Execute_ReturnOverflow;
+			ip = ip->data.word.data.compiled->code;
+			break;
+		case I_EXIT:
+			if (StackDepth(state.returns) == base) {
+				state.fuel->left = fuel;
+				return NULL; }
+			ip = RTOP(state)->ip;
+			StackPop(state.returns, NULL);
+			break;
+		case I_INT:
+			d.Int = ip->data.Int;
+			Push(state, T_INT, d);
+			++ip;
+			break;
+		case I_FLOAT:
+			if (!state.floats || !StackPush(state.floats, &ip->data.Float))
+				goto Execute_FloatOverflow;
+			++ip;
+			break;
+		case I_STRING:
+			d = ip->data.String;
+			if (Push(state, T_STRING, d)) StringRetain(d);
+			++ip;
+			break;
+		case I_BRANCH:
+			ip += ip->data.offset;
+			break;
+		case I_BRANCH0:
+			/* An empty stack reads as false. */
+			if (!Pop(state, &d) || !d.Int)
+				ip += ip->data.offset;
+			else ++ip;
+			break;
+		case I_DO:
+		case I_QDO: {
+			ForthDatum limit;
+			if (!Pop(state, &d))     d.Int = 0;
+			if (!Pop(state, &limit)) limit.Int = 0;
+			if (I_QDO == ip->type && d.Int == limit.Int) {
+				ip += ip->data.offset;
+				break; }
+			if (!PushReturn(state, (ReturnDatum){.Int = limit.Int}) ||
+			    !PushReturn(state, (ReturnDatum){.Int = d.Int}))
+				goto Execute_ReturnOverflow;
+			++ip;
+		} break;
+		case I_LOOP:
+		case I_PLUSLOOP: {
+			ReturnDatum* top = RTOP(state);
+			long n = 1;
+			if (I_PLUSLOOP == ip->type)
+				n = Pop(state, &d) ? d.Int : 0;
+			if (Crossed(top[0].Int, top[-1].Int, n)) {
+				StackPop(state.returns, NULL);
+				StackPop(state.returns, NULL);
+				++ip;
+			} else {
+				top[0].Int += n;
+				ip += ip->data.offset; }
+		} break;
+		case I_UNLOOP:
+			StackPop(state.returns, NULL);
+			StackPop(state.returns, NULL);
+			++ip;
+			break;
+		case I_INDEX:
+			/* Each enclosing loop keeps two cells: limit, then index. */
+			d.Int = RTOP(state)[-2 * ip->data.Int].Int;
+			Push(state, T_INT, d);
+			++ip;
+			break;
+		case I_PARDO:
+			state.fuel->left = fuel;
+			ip = ParallelDo(state, ip);
+			fuel = state.fuel->left;
+			break;
+		case I_CREATE: {
+			long* at = &ip->data.word.data.compiled->code[0].data.Int;
+			if (!Pop(state, &d)) d.Int = 0;
+			if (!state.data)
+				OutputError(state.output, "ERROR: No data space.\n");
+			else if (!DataCreate(state.data, d.Int, at))
+				OutputError(state.output, "ERROR: Could not allot %ld bytes.\n",
+				            d.Int);
+			++ip;
+		} break;
+		case I_LOCALS: {
+			/* Missing items are taken as 0, as I_DO takes them. */
+			const long n = ip->data.Int;
+			if (!Numbers(state, n)) goto Execute_NotNumber;
+			for (long k = 0; k < n; ++k)
+				if (!PushReturn(state, (ReturnDatum){.Int = 0}))
+					goto Execute_ReturnOverflow;
+			ReturnDatum* top = RTOP(state);
+			for (long k = 0; k < n && Pop(state, &d); ++k)
+				top[-k].Int = d.Int;
+			++ip;
+		} break;
+		case I_LOCAL:
+			d.Int = RTOP(state)[-ip->data.Int].Int;
+			Push(state, T_INT, d);
+			++ip;
+			break;
+		case I_TO:
+			if (!Numbers(state, 1)) goto Execute_NotNumber;
+			if (Pop(state, &d)) RTOP(state)[-ip->data.Int].Int = d.Int;
+			++ip;
+			break;
+		case I_ENDLOCALS:
+			for (long k = 0; k < ip->data.Int; ++k)
+				StackPop(state.returns, NULL);
+			++ip;
+			break;
+		default:
+			OutputError(state.output,
+			            "BUG: Bad instruction type %d passed to Execute.\n",
+			            ip->type);
+			goto Execute_Abort; }}
+
+	/* ERROR BLOCK */
+Execute_ReturnOverflow:
+	OutputError(state.output, "ERROR: Return stack overflow.\n");
+	goto Execute_Abort;
+Execute_NotNumber:
+	OutputError(state.output, "ERROR: Only numbers can be held in locals.\n");
+	goto Execute_Abort;
+Execute_FloatOverflow:
+	OutputError(state.output, "ERROR: Floating-point stack overflow.\n");
+	goto Execute_Abort;
+Execute_OutOfFuel:
+	state.fuel->exhausted = true;
+	if (outermost)
+		OutputError(state.output,
+		            "ERROR: Instruction budget of %lu exhausted.\n",
+		            state.budget);
+Execute_Abort:
+	state.fuel->left = fuel;
+	/* Unwind whatever this call pushed. */
+	while (StackDepth(state.returns) > base)
+		StackPop(state.returns, NULL);
+	return NULL;
+}
+
+/********** PUBLIC **********/
+_Bool ExecuteExhausted(struct State state)
+{
+	return state.fuel && state.fuel->exhausted;
+}
+
+void Execute(struct State state, const struct Definition* def)
+{
+	cassert(state.stack);
+	cassert(state.returns);
+	cassert(def);
+
+	/// Frames below the current depth belong to whoever called Execute.
+	Run(state, def->code, StackDepth(state.returns), false);
+}
+
+void ExecuteCode(struct State state, const Instruction* ip)
+{
+	cassert(state.stack);
+	cassert(state.returns);
+	cassert(ip);
+
+	Run(state, ip, StackDepth(state.returns), false);
+}
+
+const Instruction* Resume(struct State state, const Instruction* ip)
+{
+	cassert(state.stack);
+	cassert(state.returns);
+	cassert(state.tasks);
+	cassert(ip);
+
+	return Run(state, ip, 0, true);
+}
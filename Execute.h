@@ -0,0 +1,25 @@
+#ifndef EXECUTE_H
+#define EXECUTE_H
+
+#include "ForthTypes.h"
+
+/* Runs a compiled definition to completion: the inner interpreter. */
+/* Calls between compiled definitions, and loop parameters,
+   are kept on `state.returns` rather than on the C stack. */
+/* Gives up, with an error, after `state.budget` instructions, if any,
+   counting those of whatever it runs in turn, as by EVALUATE. */
+void Execute(struct State state, const struct Definition* def);
+
+/* As Execute, but runs code from `ip` until its I_EXIT; see 'Parallel.h'. */
+void ExecuteCode(struct State state, const Instruction* ip);
+
+/* Returns true once the run a builtin is called from has run out of budget,
+   and is being given up on, so that the builtin should stop too. */
+_Bool ExecuteExhausted(struct State state);
+
+/* Runs a task, whose code is resumed at `ip` with `state.returns` holding
+   its frames, until it ends, returning NULL, or until it pauses or has run
+   `state.budget` instructions, returning where to resume it; see 'Task.h'. */
+const Instruction* Resume(struct State state, const Instruction* ip);
+
+#endif /* EXECUTE_H */
@@ -0,0 +1,56 @@
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcpy
+#include <stdbool.h>
+
+#include "ForthString.h"
+#include "ForthTypes.h"
+#include "Assert.h"
+
+_Bool StringNew(ForthDatum* d, const char* text, size_t length)
+{
+	cassert(d);
+	cassert(text);
+
+	if (length <= STRING_SHORT) {
+		d->Short[STRING_TAG] = (char)(length << 1 | 1);
+		memcpy(d->Short + STRING_TEXT, text, length);
+		d->Short[STRING_TEXT + length] = '\0';
+		return true; }
+
+	struct StringHead* h = malloc(sizeof(*h) + length + 1);
+	sassert(h); // STRICT
+	if (!h) return false;
+
+	h->refs   = 1;
+	h->length = length;
+	char* s = (char*)(h + 1);
+	memcpy(s, text, length);
+	s[length] = '\0';
+	d->String = s;
+	return true;
+}
+
+void StringRetain(ForthDatum d)
+{
+	if (StringIsShort(d)) return;
+	cassert(d.String);
+	struct StringHead* h = STRING_HEAD(d.String);
+	if (STRING_STATIC != h->refs) ++h->refs;
+}
+
+void StringRelease(ForthDatum d)
+{
+	if (StringIsShort(d)) return;
+	cassert(d.String);
+	struct StringHead* h = STRING_HEAD(d.String);
+	if (STRING_STATIC == h->refs) return;
+	if (--h->refs) return;
+	free(h);
+}
+
+size_t StringLength(ForthDatum d)
+{
+	if (StringIsShort(d)) return (unsigned char)d.Short[STRING_TAG] >> 1;
+	cassert(d.String);
+	return STRING_HEAD(d.String)->length;
+}
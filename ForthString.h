@@ -0,0 +1,56 @@
+#ifndef FORTH_STRING_H
+#define FORTH_STRING_H
+#include <stddef.h>
+#include "ForthTypes.h"
+
+/* Strings on the stack, and in compiled code, are never changed, so they
+   are shared instead of copied: a string is a pointer to NUL-terminated
+   text, preceded by its length and a count of its owners. */
+struct StringHead {
+	_Atomic unsigned long refs;
+	unsigned long length;
+};
+
+/* The head in front of the text `s`. */
+#define STRING_HEAD(s) ((struct StringHead*)(s) - 1)
+
+/* Value of `refs` for strings that aren't owned by anything, such as those
+   mapped from an image. Retaining and releasing those does nothing. */
+#define STRING_STATIC 0
+
+/* Strings this short are kept in the ForthDatum itself, NUL-terminated,
+   beside a tag byte: the low byte of the pointer a long string would
+   have, which is odd only for short ones, as heads are aligned. */
+#define STRING_SHORT (sizeof(ForthDatum) - 2)
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define STRING_TAG  (sizeof(ForthDatum) - 1)
+#define STRING_TEXT 0
+#else
+#define STRING_TAG  0
+#define STRING_TEXT 1
+#endif
+
+static inline _Bool StringIsShort(ForthDatum d)
+{
+	return d.Short[STRING_TAG] & 1;
+}
+
+/* The text of the string `d`, which lasts as long as `*d` does. */
+static inline const char* StringText(const ForthDatum* d)
+{
+	return StringIsShort(*d) ? d->Short + STRING_TEXT : d->String;
+}
+
+/* Makes `*d` a string of `length` characters of `text`, with one owner.
+   Returns false on allocation failure. */
+_Bool StringNew(ForthDatum* d, const char* text, size_t length);
+
+/* Adds an owner to `d`. */
+void StringRetain(ForthDatum d);
+
+/* Removes an owner from `d`, freeing it once no owners remain. */
+void StringRelease(ForthDatum d);
+
+size_t StringLength(ForthDatum d);
+
+#endif /* FORTH_STRING_H */
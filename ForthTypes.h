@@ -1,5 +1,6 @@
 #ifndef FORTH_TYPES_H
 #define FORTH_TYPES_H
+#include <stdio.h>
 #include "Dict.h"
 #include "Stack.h"
 
@@ -10,21 +11,119 @@ struct State {
 
 	/// Stores information about the types of the things that are one the stack.
 	Stack types; /* Can be NULL if typing is not intended. */
+
+	/// Return addresses and loop parameters of executing compiled words.
+	Stack returns; /* Holds ReturnDatum elements. */
+
+	/// Words beneath `namespace`, shared with other states; see 'Session.h'.
+	Dict shared; /* Can be NULL. Never changed through this state. */
+
+	/// Where builtins print to; see 'Output.h'.
+	struct Output* output;
+
+	/// Tasks that PAUSE switches between; see 'Task.h'.
+	struct Tasks* tasks; /* Can be NULL, leaving PAUSE nothing to do. */
+
+	/// Channels that CHAN makes, shared with its tasks and threads.
+	struct Channels* channels; /* See 'Channel.h'. */
+
+	/// Instructions that each Execute, or each turn of a task, may take.
+	unsigned long budget; /* 0 for no limit. */
+
+	/// What is left of it to the run under way, as EVALUATE draws on it.
+	struct Fuel* fuel; /* NULL outside of a run; see 'Execute.h'. */
+
+	/// Memory for HERE, ALLOT, @ and !; see 'DataSpace.h'.
+	struct DataSpace* data; /* Can be NULL, for none. */
+
+	/// Floating-point numbers, kept apart from the data stack.
+	Stack floats; /* Holds doubles. Can be NULL, for none. */
+
+	/// Whether words that write files, as SAVE-IMAGE does, are refused.
+	_Bool confined; /* As for sessions served to clients; see 'Server.h'. */
 };
 
-// TODO: Have a function type that stores a forth 'expression.'
-enum function_type { F_BUILTIN };
+/* What is left of the budget of a run, which the runs nested in it share. */
+struct Fuel {
+	unsigned long left;
+	_Bool exhausted; /* Once it ran out, giving up on every run sharing it. */
+};
+
+/* A compiled colon definition; see 'Definition.h'. */
+struct Definition;
+
+enum function_type { F_BUILTIN, F_COMPILED };
 typedef struct {
 	union {
 		void(*builtin)(struct State state);
+		struct Definition* compiled;
 	}data; // C99 compat
 	enum function_type type;
 }ForthWord;
 
-enum datum_type { T_INT, T_STRING };
+enum datum_type { T_INT, T_STRING, T_VECTOR };
 typedef union {
-	long  Int;
-	char* String;
+	long        Int;
+	/* Strings; see 'ForthString.h'. */
+	const char* String;                /* Shared with other owners, or */
+	char        Short[sizeof(char*)];  /* short enough to be kept here. */
+	/* Vectors of cells, shared too; see 'ForthVector.h'. */
+	struct Vector* Vector;
 }ForthDatum;
 
+/* Instructions making up the body of a compiled definition. */
+/* Branch offsets are relative to the branching instruction itself. */
+enum instruction_type {
+	I_CALL,    /* Call `word`.                                              */
+	I_INT,     /* Push `Int`.                                               */
+	I_STRING,  /* Push the string `String`, held by the definition.         */
+	I_FLOAT,   /* Push `Float` onto the floating-point stack.               */
+	I_BRANCH,  /* Jump by `offset`.                                         */
+	I_BRANCH0, /* Pop a flag, jump by `offset` if it is zero.               */
+	I_DO,      /* Move a limit and a starting index to the return stack.    */
+	I_QDO,     /* As I_DO, but jump by `offset` if the two are equal.       */
+	I_LOOP,    /* Step the index by one, jump by `offset` until the limit.  */
+	I_PLUSLOOP,/* Step the index by a popped amount, as I_LOOP otherwise.   */
+	I_UNLOOP,  /* Discard the innermost loop's parameters.                  */
+	I_INDEX,   /* Push the index of the loop `Int` levels out (I, J).       */
+	I_PARDO,   /* Pop a limit and a start, run the body that follows for
+	              each index in between on several threads, and combine the
+	              results with the I_CALL that ends it; jump by `offset`.  */
+	I_CREATE,  /* Pop a size, allot that much, and set the I_INT starting
+	              the compiled `word`, defined by CREATE, to its address.  */
+	I_LOCALS,  /* Pop `Int` cells into a frame of locals on the return stack,
+	              the topmost into the last of them.                        */
+	I_LOCAL,   /* Push the local `Int` cells down the return stack.         */
+	I_TO,      /* Pop a cell into the local `Int` cells down, as I_LOCAL.   */
+	I_ENDLOCALS,/* Discard the frame of `Int` locals.                       */
+	I_EXIT     /* Return to the caller.                                     */
+};
+typedef struct Instruction {
+	union {
+		ForthWord word;
+		long       Int;
+		ForthDatum String;
+		double     Float;
+		long       offset;
+	}data;
+	enum instruction_type type;
+}Instruction;
+
+struct Definition {
+	/* Owners: namespace entries and calling code, possibly on other threads,
+	   as sessions share their snapshot's definitions. */
+	_Atomic unsigned long refs;
+	unsigned long length; /* Number of instructions in `code`.           */
+	/* Set on words defined by CREATE, whose I_INT is set as they allot,
+	   after they are compiled; they are never inlined. */
+	_Bool created;
+	Instruction code[];
+};
+
+/* Items of the return stack. */
+typedef union {
+	const Instruction* ip;
+	long Int;
+}ReturnDatum;
+
 #endif // FORTH_TYPES_H
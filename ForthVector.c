@@ -0,0 +1,328 @@
+#include <stdlib.h> // malloc, free
+#include <stdbool.h>
+#include <stdint.h> // SIZE_MAX
+
+#include "ForthVector.h"
+#include "ForthTypes.h"
+#include "Assert.h"
+
+/* AVX2 kernels are built alongside the plain ones, and picked only on CPUs
+   that have it, so that the build runs anywhere. */
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+/* Cells wrap around on overflow, where signed arithmetic wouldn't. */
+#define WRAP(op, a, b) ((long)((unsigned long)(a) op (unsigned long)(b)))
+
+/********** PRIVATE: SCALAR KERNELS **********/
+static long SumScalar(const long* a, size_t n)
+{
+	long sum = 0;
+	for (size_t i = 0; i < n; ++i) sum = WRAP(+, sum, a[i]);
+	return sum;
+}
+
+static long DotScalar(const long* a, const long* b, size_t n)
+{
+	long sum = 0;
+	for (size_t i = 0; i < n; ++i) sum = WRAP(+, sum, WRAP(*, a[i], b[i]));
+	return sum;
+}
+
+static void AddScalar(long* out, const long* a, const long* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) out[i] = WRAP(+, a[i], b[i]);
+}
+
+static void MulScalar(long* out, const long* a, const long* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) out[i] = WRAP(*, a[i], b[i]);
+}
+
+static void MaxScalar(long* out, const long* a, const long* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) out[i] = a[i] > b[i] ? a[i] : b[i];
+}
+
+static double FSumScalar(const double* a, size_t n)
+{
+	double sum = 0;
+	for (size_t i = 0; i < n; ++i) sum += a[i];
+	return sum;
+}
+
+static double FDotScalar(const double* a, const double* b, size_t n)
+{
+	double sum = 0;
+	for (size_t i = 0; i < n; ++i) sum += a[i] * b[i];
+	return sum;
+}
+
+static void FAddScalar(double* out, const double* a, const double* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) out[i] = a[i] + b[i];
+}
+
+static void FMulScalar(double* out, const double* a, const double* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) out[i] = a[i] * b[i];
+}
+
+/* As MAXPD has it: the second, unless the first is greater. */
+static void FMaxScalar(double* out, const double* a, const double* b, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) out[i] = a[i] > b[i] ? a[i] : b[i];
+}
+
+/********** PRIVATE: AVX2 KERNELS **********/
+/* Each handles as many elements as fill whole registers, four at a time,
+   and returns how many that was; the scalar kernels do the rest. */
+#ifdef AVX2
+#define HAS_AVX2() __builtin_cpu_supports("avx2")
+#define LOAD(p)     _mm256_loadu_si256((const __m256i*)(p))
+#define STORE(p, x) _mm256_storeu_si256((__m256i*)(p), (x))
+
+/* AVX2 has no 64 bit multiply: it's made from 32 bit ones. */
+AVX2 static inline __m256i Mul64(__m256i a, __m256i b)
+{
+	const __m256i cross =
+		_mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+		                 _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+	return _mm256_add_epi64(_mm256_mul_epu32(a, b),
+	                        _mm256_slli_epi64(cross, 32));
+}
+
+AVX2 static long Reduce(__m256i x)
+{
+	long lanes[4];
+	STORE(lanes, x);
+	return WRAP(+, WRAP(+, lanes[0], lanes[1]), WRAP(+, lanes[2], lanes[3]));
+}
+
+AVX2 static size_t SumAVX2(const long* a, size_t n, long* sum)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) acc = _mm256_add_epi64(acc, LOAD(a + i));
+	*sum = Reduce(acc);
+	return i;
+}
+
+AVX2 static size_t DotAVX2(const long* a, const long* b, size_t n, long* sum)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = _mm256_add_epi64(acc, Mul64(LOAD(a + i), LOAD(b + i)));
+	*sum = Reduce(acc);
+	return i;
+}
+
+AVX2 static size_t AddAVX2(long* out, const long* a, const long* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		STORE(out + i, _mm256_add_epi64(LOAD(a + i), LOAD(b + i)));
+	return i;
+}
+
+AVX2 static size_t MulAVX2(long* out, const long* a, const long* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		STORE(out + i, Mul64(LOAD(a + i), LOAD(b + i)));
+	return i;
+}
+
+AVX2 static size_t MaxAVX2(long* out, const long* a, const long* b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256i x = LOAD(a + i), y = LOAD(b + i);
+		STORE(out + i, _mm256_blendv_epi8(y, x, _mm256_cmpgt_epi64(x, y))); }
+	return i;
+}
+
+AVX2 static double FReduce(__m256d x)
+{
+	double lanes[4];
+	_mm256_storeu_pd(lanes, x);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+AVX2 static size_t FSumAVX2(const double* a, size_t n, double* sum)
+{
+	__m256d acc = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) acc = _mm256_add_pd(acc, _mm256_loadu_pd(a + i));
+	*sum = FReduce(acc);
+	return i;
+}
+
+AVX2 static size_t FDotAVX2(const double* a, const double* b, size_t n,
+                            double* sum)
+{
+	__m256d acc = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+		                                       _mm256_loadu_pd(b + i)));
+	*sum = FReduce(acc);
+	return i;
+}
+
+AVX2 static size_t FAddAVX2(double* out, const double* a, const double* b,
+                            size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i),
+		                                        _mm256_loadu_pd(b + i)));
+	return i;
+}
+
+AVX2 static size_t FMulAVX2(double* out, const double* a, const double* b,
+                            size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+		                                        _mm256_loadu_pd(b + i)));
+	return i;
+}
+
+AVX2 static size_t FMaxAVX2(double* out, const double* a, const double* b,
+                            size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(out + i, _mm256_max_pd(_mm256_loadu_pd(a + i),
+		                                        _mm256_loadu_pd(b + i)));
+	return i;
+}
+#else
+/* Elsewhere, the scalar kernels do it all. */
+#define HAS_AVX2() false
+#define SumAVX2(a, n, sum)    0
+#define DotAVX2(a, b, n, sum) 0
+#define AddAVX2(out, a, b, n) 0
+#define MulAVX2(out, a, b, n) 0
+#define MaxAVX2(out, a, b, n) 0
+#define FSumAVX2(a, n, sum)    0
+#define FDotAVX2(a, b, n, sum) 0
+#define FAddAVX2(out, a, b, n) 0
+#define FMulAVX2(out, a, b, n) 0
+#define FMaxAVX2(out, a, b, n) 0
+#endif
+
+/********** PUBLIC **********/
+struct Vector* VectorNew(unsigned long length, enum vector_kind kind)
+{
+	if (length > (SIZE_MAX - sizeof(struct Vector)) / sizeof(long))
+		return NULL;
+	struct Vector* v = malloc(sizeof(*v) + length * sizeof(long));
+	if (!v) return NULL;
+	v->refs   = 1;
+	v->length = length;
+	v->kind   = kind;
+	return v;
+}
+
+void VectorRetain(struct Vector* v)
+{
+	cassert(v);
+	++v->refs;
+}
+
+void VectorRelease(struct Vector* v)
+{
+	cassert(v);
+	if (--v->refs) return;
+	free(v);
+}
+
+long VectorSum(const struct Vector* v)
+{
+	cassert(v);
+	cassert(V_CELLS == v->kind);
+	long sum = 0;
+	const size_t done = HAS_AVX2() ? SumAVX2(v->elements, v->length, &sum) : 0;
+	return WRAP(+, sum, SumScalar(v->elements + done, v->length - done));
+}
+
+long VectorDot(const struct Vector* v1, const struct Vector* v2)
+{
+	cassert(v1);
+	cassert(v2);
+	cassert(v1->length == v2->length);
+	cassert(V_CELLS == v1->kind && V_CELLS == v2->kind);
+	const size_t n = v1->length;
+	long sum = 0;
+	const size_t done =
+		HAS_AVX2() ? DotAVX2(v1->elements, v2->elements, n, &sum) : 0;
+	return WRAP(+, sum, DotScalar(v1->elements + done, v2->elements + done,
+	                              n - done));
+}
+
+double VectorFSum(const struct Vector* v)
+{
+	cassert(v);
+	cassert(V_FLOATS == v->kind);
+	const double* a = (const double*)v->elements;
+	double sum = 0;
+	const size_t done = HAS_AVX2() ? FSumAVX2(a, v->length, &sum) : 0;
+	return sum + FSumScalar(a + done, v->length - done);
+}
+
+double VectorFDot(const struct Vector* v1, const struct Vector* v2)
+{
+	cassert(v1);
+	cassert(v2);
+	cassert(v1->length == v2->length);
+	cassert(V_FLOATS == v1->kind && V_FLOATS == v2->kind);
+	const double* a = (const double*)v1->elements;
+	const double* b = (const double*)v2->elements;
+	const size_t n = v1->length;
+	double sum = 0;
+	const size_t done = HAS_AVX2() ? FDotAVX2(a, b, n, &sum) : 0;
+	return sum + FDotScalar(a + done, b + done, n - done);
+}
+
+/* Runs the map kernel for elements of `type`, vectorized as far as it
+   goes. */
+#define MAP(name, type, out, v1, v2) do { \
+	type* o = (type*)out->elements; \
+	const type* a = (const type*)v1->elements; \
+	const type* b = (const type*)v2->elements; \
+	const size_t n = v1->length; \
+	const size_t done = HAS_AVX2() ? name##AVX2(o, a, b, n) : 0; \
+	name##Scalar(o + done, a + done, b + done, n - done); \
+} while (0)
+
+/* Checks the operands of a map, and runs the kernel for their kind. */
+#define MAPS(name, out, v1, v2) do { \
+	cassert(out); \
+	cassert(v1); \
+	cassert(v2); \
+	cassert(v1->length == v2->length && out->length == v1->length); \
+	cassert(v1->kind == v2->kind && out->kind == v1->kind); \
+	if (V_FLOATS == out->kind) MAP(F##name, double, out, v1, v2); \
+	else MAP(name, long, out, v1, v2); \
+} while (0)
+
+void VectorAdd(struct Vector* out, const struct Vector* v1, const struct Vector* v2)
+{
+	MAPS(Add, out, v1, v2);
+}
+
+void VectorMul(struct Vector* out, const struct Vector* v1, const struct Vector* v2)
+{
+	MAPS(Mul, out, v1, v2);
+}
+
+void VectorMax(struct Vector* out, const struct Vector* v1, const struct Vector* v2)
+{
+	MAPS(Max, out, v1, v2);
+}
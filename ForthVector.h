@@ -0,0 +1,51 @@
+#ifndef FORTH_VECTOR_H
+#define FORTH_VECTOR_H
+#include <stddef.h>
+#include "ForthTypes.h"
+
+/* Vectors of cells or floats, which, being never changed once made, are
+   shared as strings are: a vector is its elements, behind their count and
+   a count of their owners. */
+enum vector_kind { V_CELLS, V_FLOATS };
+struct Vector {
+	_Atomic unsigned long refs;
+	unsigned long length;
+	enum vector_kind kind;
+	long elements[]; /* Of V_FLOATS vectors, read through VectorFloats. */
+};
+
+static inline double* VectorFloats(struct Vector* v)
+{
+	return (double*)v->elements;
+}
+
+/* Returns a vector of `length` elements of `kind`, yet to be set, with one
+   owner, or NULL on failed allocation. */
+struct Vector* VectorNew(unsigned long length, enum vector_kind kind);
+
+/* Adds an owner to `v`. */
+void VectorRetain(struct Vector* v);
+
+/* Removes an owner from `v`, freeing it once no owners remain. */
+void VectorRelease(struct Vector* v);
+
+/* The kernels below are vectorized where the CPU allows, which is checked
+   as they run. Cells wrap around on overflow; floats are added up in a
+   different order when vectorized, so they can round differently. */
+
+/* For V_CELLS vectors. */
+long VectorSum(const struct Vector* v);
+/* `v1` and `v2` must be of the same length and kind, as must `out` below. */
+long VectorDot(const struct Vector* v1, const struct Vector* v2);
+
+/* For V_FLOATS vectors. */
+double VectorFSum(const struct Vector* v);
+double VectorFDot(const struct Vector* v1, const struct Vector* v2);
+
+/* Set `out` to the sums, products, or greater, of the elements of `v1`
+   and `v2` in turn, whichever their kind. `out` can be either of them. */
+void VectorAdd(struct Vector* out, const struct Vector* v1, const struct Vector* v2);
+void VectorMul(struct Vector* out, const struct Vector* v1, const struct Vector* v2);
+void VectorMax(struct Vector* out, const struct Vector* v1, const struct Vector* v2);
+
+#endif /* FORTH_VECTOR_H */
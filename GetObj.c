@@ -1,57 +1,305 @@
 #include <stdio.h>
-#include <stdlib.h> // alloca
-#include <alloca.h>
+#include <stdlib.h> // malloc, free, strtod
 #include <assert.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <errno.h>
+#include <string.h> // memcpy
+#include <stdint.h>
+#include <math.h>   // HUGE_VAL
+#include <limits.h> // LONG_MAX
+#include <pthread.h>
+#include <unistd.h> // isatty
 
 #include "GetObj.h"
 #include "Eval.h"
 #include "ForthTypes.h"
 
 #include "Debug.h"
-#include "Strdup.h"
 
 /* Maximum amount of characters grabbed at one time. */
 #define MAX_GRAB_SIZE 512
 
 #define ISSEP(c) ((c) == ' ' || (c) == '\t' || (c) == '\n')
 
-/* Global stream */
-static FILE* G_Stream = NULL;
+/* Input that isn't interactive is read this much at a time. */
+#define BLOCK_SIZE (64 * 1024)
+/* The most of a line that can be carried over from one block to the next;
+   longer lines are split, as fgets splits those longer than a line. */
+#define MAX_CARRY  (8 * MAX_GRAB_SIZE)
+
+/* Tokens' text is kept in chunks this large, other than a longer token's. */
+#define ARENA_SIZE (4 * MAX_GRAB_SIZE)
+
+/* Where the text of tokens is copied, one after another, each only needed
+   until the next is read. It's started over in bulk, once the line or
+   block tokens are read from is done with, or once it fills up. */
+struct arena {
+	size_t used;
+	char* big;   /* A token too long for `chunk`, or NULL. */
+	char chunk[ARENA_SIZE];
+};
+
+/* A block of input, behind room for what's carried over from the last. */
+struct block {
+	char* buf; /* MAX_CARRY + BLOCK_SIZE + 1 bytes. */
+	size_t n;
+	_Bool full;  /* Whether it is the reader's, rather than the filler's. */
+	_Bool last;  /* Whether the stream ends with it. */
+};
+
+/* Blocks being read ahead, while the other is tokenized. */
+struct readAhead {
+	FILE* stream;
+	pthread_t filler;
+	_Bool threaded; /* Otherwise blocks are filled as they're needed. */
+	_Bool stop;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	struct block blocks[2];
+
+	unsigned current;
+	char* text;  /* What is tokenized of the current block, or NULL. */
+	char* cut;   /* Where `text` was cut short, at a line's end. */
+	char saved;  /* What was at `cut`. */
+	unsigned long idx;
+	struct arena* tokens;
+};
+
+/* A reader's state, the closure of GetObj_. */
+struct GetObj {
+	FILE* stream;
+	char line[MAX_GRAB_SIZE];
+	unsigned long idx; /* Where in `line` reading resumes. */
+	struct readAhead* ahead; /* NULL if reading lines. */
+	struct arena tokens;
+};
+
+/* A reader of a string, which it doesn't own. */
+struct StringObj {
+	const char* text;
+	unsigned long idx;
+	struct arena tokens;
+};
+
+/* Copies `n` characters of `s` into the arena, NUL-terminated. */
+static char* Keep(struct arena* a, const char* s, size_t n)
+{
+	char* copy;
+	if (n >= ARENA_SIZE) {
+		free(a->big);
+		if (!(copy = a->big = malloc(n + 1))) return NULL;
+	} else {
+		/* Whatever it holds has been read past. */
+		if (n >= ARENA_SIZE - a->used) a->used = 0;
+		copy = a->chunk + a->used;
+		a->used += n + 1; }
+	memcpy(copy, s, n);
+	copy[n] = '\0';
+	return copy;
+}
+
+static void Reset(struct arena* a)
+{
+	a->used = 0;
+	free(a->big);
+	a->big = NULL;
+}
+
+static inline unsigned long readWord(const char* ringSub,
+                                     enum object_type* typeSlot,
+                                     Object* objectSlot,
+                                     struct arena* tokens);
+
+/* Powers of ten that doubles hold exactly. */
+static const double ExactPowers[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+/* Reads a decimal fraction, such as `-1.5` or `25e-3`, which has a point or
+   an exponent, up to the end of the token; returns false if it isn't one. */
+/* When the digits fit in a double's mantissa, and the power of ten is exact,
+   a single multiply or divide rounds correctly, as strtod would; only the
+   rest are left to strtod. */
+static _Bool ParseFractional(const char* s, double* value, const char** end)
+{
+	const char* p = s;
+	const _Bool negative = '-' == *p;
+	if (negative) ++p;
+
+	uint64_t mantissa = 0;
+	long exponent = 0;
+	_Bool digits = false, point = false, exact = true;
+	for (;; ++p)
+		if (isdigit((unsigned char)*p)) {
+			digits = true;
+			if (mantissa > (UINT64_MAX - 9) / 10) exact = false;
+			else {
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				if (point) --exponent; }}
+		else if ('.' == *p && !point) point = true;
+		else break;
+	if (!digits) return false;
+
+	_Bool marked = point;
+	if ('e' == *p || 'E' == *p) {
+		++p;
+		const _Bool down = '-' == *p;
+		if ('-' == *p || '+' == *p) ++p;
+		if (!isdigit((unsigned char)*p)) return false;
+		long e = 0;
+		for (; isdigit((unsigned char)*p); ++p)
+			if (e < 100000) e = e * 10 + (*p - '0');
+		exponent += down ? -e : e;
+		marked = true; }
+	if (!marked || (*p && !ISSEP(*p))) return false;
+	*end = p;
+
+	if (exact && mantissa <= (uint64_t)1 << 53 &&
+	    exponent >= -22 && exponent <= 22) {
+		const double m = (double)mantissa;
+		const double v = exponent < 0 ? m / ExactPowers[-exponent]
+		                              : m * ExactPowers[exponent];
+		*value = negative ? -v : v;
+		return true; }
+	*value = strtod(s, NULL);
+	return true;
+}
+
+static inline unsigned long readFractional(const char* ringSub,
+                                           enum object_type* typeSlot,
+                                           Object* objectSlot,
+                                           struct arena* tokens) {
+	double value;
+	const char* end;
+	/* Otherwise the token merely starts like a number, as `0=` or `2DUP`
+	   do. */
+	if (!ParseFractional(ringSub, &value, &end))
+		return readWord(ringSub, typeSlot, objectSlot, tokens);
+
+	if (HUGE_VAL == value || -HUGE_VAL == value) {
+		*typeSlot = O_ERROR;
+		objectSlot->error = (struct error) {.type = E_BADNUM,
+		                                    .bad_string = ringSub};
+	} else {
+		*typeSlot = O_FRACTIONAL;
+		objectSlot->fractional = value; }
+	return (unsigned long) (end-ringSub);
+}
+
+/* The value of `c` as a digit, which is at least 36 if it isn't one. */
+static inline unsigned DigitValue(char c)
+{
+	if (c >= '0' && c <= '9') return (unsigned)(c - '0');
+	c |= 0x20; /* Lower case. */
+	if (c >= 'a' && c <= 'z') return (unsigned)(c - 'a') + 10;
+	return 36;
+}
+
+/* The value of eight decimal digits, converted SWAR: with one load and
+   three multiplies, rather than eight of each. The first digit is taken
+   to be in the lowest byte. */
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SWAR_DIGITS 8
+static inline uint64_t EightDigitsValue(uint64_t chunk)
+{
+	chunk -= 0x3030303030303030;
+	chunk = chunk * 10 + (chunk >> 8);  /* Pairs of digits. */
+	return (((chunk & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+	        (((chunk >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32))))
+	       >> 32;
+}
+#endif
+
+/* Reads the integer `text` spells, up to the end of the token, in `base`,
+   unless it's prefixed: `$` or `0x` for hexadecimal, `#` for decimal, `%`
+   for binary. A '-' can come first. */
+/* Returns the length of the token, or 0 if it isn't an integer. `*overflow`
+   is set if it doesn't fit in a cell. */
+static size_t ParseIntegral(const char* text, unsigned base,
+                            long* value, _Bool* overflow)
+{
+	const char* p = text;
+	const _Bool negative = '-' == *p;
+	if (negative) ++p;
+	switch (*p) {
+	case '$': base = 16; ++p; break;
+	case '#': base = 10; ++p; break;
+	case '%': base = 2;  ++p; break;
+	case '0':
+		if ('x' == p[1] || 'X' == p[1]) {
+			base = 16;
+			p += 2; }
+		break; }
+
+	/* Negative numbers go one further, to LONG_MIN. */
+	const unsigned long limit = (unsigned long)LONG_MAX + negative;
+	const unsigned long cutoff = limit / base, cutlim = limit % base;
+	unsigned long n = 0;
+	*overflow = false;
+	const char* digits = p;
+	for (;;) {
+#ifdef SWAR_DIGITS
+		/* The end of the token isn't known yet, and loading past it could
+		   run off the end of the text: eight digits must be seen first. */
+		if (10 == base) {
+			size_t k = 0;
+			while (k < SWAR_DIGITS && p[k] >= '0' && p[k] <= '9') ++k;
+			if (SWAR_DIGITS == k) {
+				uint64_t chunk;
+				memcpy(&chunk, p, sizeof(chunk));
+				const unsigned long eight = EightDigitsValue(chunk);
+				if (n > limit / 100000000 ||
+				    (n == limit / 100000000 && eight > limit % 100000000))
+					*overflow = true;
+				else n = n * 100000000 + eight;
+				p += SWAR_DIGITS;
+				continue; }}
+#endif
+		const unsigned d = DigitValue(*p);
+		if (d >= base) break;
+		if (n > cutoff || (n == cutoff && d > cutlim)) *overflow = true;
+		else n = n * base + d;
+		++p; }
+	if (p == digits || (*p && !ISSEP(*p))) return 0;
+	*value = negative ? (long)(0 - n) : (long)n;
+	return (size_t)(p - text);
+}
 
 static inline unsigned long readIntegral(const char* ringSub,
+                                         unsigned base,
                                          enum object_type* typeSlot,
-                                         Object* objectSlot) {
+                                         Object* objectSlot,
+                                         struct arena* tokens) {
 	assert(ringSub);
 	assert(typeSlot);
 	assert(objectSlot);
 
-	char* endptr;
-	long l = strtol(ringSub, &endptr, 0);
+	long value;
+	_Bool overflow;
+	const size_t length = ParseIntegral(ringSub, base, &value, &overflow);
 
-	/* If a bad character was encountered, and it isn't a separator. */
-	if (endptr[0] && !ISSEP(endptr[0])) {
+	/* Otherwise the token is a fraction, if numbers are decimal, or merely
+	   starts like a number, as `-`, `0=` or `2DUP` do. */
+	if (!length)
+		return 10 == base ? readFractional(ringSub, typeSlot, objectSlot, tokens)
+		                  : readWord(ringSub, typeSlot, objectSlot, tokens);
+
+	if (overflow) {
 		*typeSlot = O_ERROR;
 		objectSlot->error = (struct error) {.type = E_BADNUM,
 		                                    .bad_string = ringSub};
-		goto readIntegral_Return; }
-
-	*typeSlot = O_INTEGRAL;
-	objectSlot->integral = l;
-
-	DEBUG_PRINTF("readIntegral: Read %lu\n", (unsigned long) (endptr-ringSub));
-	readIntegral_Return:
-
-	 // Skip to the end of string or separator,
-	 // so as to not consume erroneous chars still part of the integral literal.
-	while (*endptr && !ISSEP(*endptr)) ++endptr;
-	return (unsigned long) (endptr-ringSub);
+	} else {
+		*typeSlot = O_INTEGRAL;
+		objectSlot->integral = value; }
+	DEBUG_PRINTF("readIntegral: Read %lu\n", (unsigned long)length);
+	return (unsigned long)length;
 }
 
 static inline unsigned long readString(const char* ringSub,
                                        enum object_type* typeSlot,
-                                       Object* objectSlot) {
+                                       Object* objectSlot,
+                                       struct arena* tokens) {
 	assert(ringSub);
 	assert(typeSlot);
 	assert(objectSlot);
@@ -59,13 +307,17 @@ static inline unsigned long readString(const char* ringSub,
 	++ringSub; // Skip past initial '"'
 	unsigned long i;
 	for(i = 0; ringSub[i] != '"'; ++i)
-		if (!ringSub[i]) {
+		if (!ringSub[i] || '\n' == ringSub[i]) { /* Strings end with lines. */
 			*typeSlot = O_ERROR;
 			objectSlot->error = (struct error) {.type = E_UNTERMINATED_STRING,
 			                                    .bad_string = ringSub};
-			goto readString_Return; }
+			return i+1; /* Up to the end, which is left for the caller. */ }
+	if (!(objectSlot->string = Keep(tokens, ringSub, i))) {
+		*typeSlot = O_ERROR;
+		objectSlot->error = (struct error) {.type = E_LINETOOLONG,
+		                                    .bad_string = NULL};
+		goto readString_Return; }
 	*typeSlot = O_STRING;
-	objectSlot->string = pstrndup(ringSub, i);
 
 	DEBUG_PRINTF("readString: Read %lu\n", i+2);
 readString_Return:
@@ -74,16 +326,21 @@ readString_Return:
 
 static inline unsigned long readWord(const char* ringSub,
                                      enum object_type* typeSlot,
-                                     Object* objectSlot) {
+                                     Object* objectSlot,
+                                     struct arena* tokens) {
 	assert(ringSub);
 	assert(typeSlot);
 	assert(objectSlot);
 
 	/* TODO: Handle errors. */
 	unsigned long i;
-	for(i = 0; !ISSEP(ringSub[i]); ++i);
+	for(i = 0; ringSub[i] && !ISSEP(ringSub[i]); ++i);
+	if (!(objectSlot->word = Keep(tokens, ringSub, i))) {
+		*typeSlot = O_ERROR;
+		objectSlot->error = (struct error) {.type = E_LINETOOLONG,
+		                                    .bad_string = NULL};
+		return i; }
 	*typeSlot = O_WORD;
-	objectSlot->word = pstrndup(ringSub, i);
 	return i;
 }
 
@@ -98,38 +355,40 @@ static int fpeek(FILE* fd) {
    to implement a lexer and parser as a single entity, rather
    than having to generate lexemes and pass over them seperately.
    Forth is one such language. */
-/* Gets a single lexeme-like entity. */
-static enum object_type GetObj_(Object* slot) {
-	static char line[MAX_GRAB_SIZE] = {'\0'};
-	static unsigned long idx = 0;
+/* Gets a single lexeme-like entity from `text`, starting at `*idx`, which
+   is moved past it, copying its text into `tokens`, and reading numbers in
+   `base`. Returns O_EOF at the end of the text. */
+static enum object_type Scan(const char* text, unsigned long* idx,
+                             Object* slot, struct arena* tokens,
+                             unsigned base)
+{
+	unsigned long i = *idx;
 	unsigned long readLength = 0;
 	enum object_type ret;
 
-	goto start;
-Refill:
-	// TODO: implement Refill: properly.
-	// TODO: Use fgets only if interraction is required, fread otherwise.
-	// TODO: Allow the interpretation of a string, independent of its source.
-	if (fpeek(G_Stream) == EOF) return O_EOF;
-	fgets(line, sizeof(line)/sizeof(*line), G_Stream);
-	idx = 0;
-start:
 	for(;;) {
-		DEBUG_PRINTF("Switching on %d, `%c`\n", line[idx], line[idx]);
-		DEBUG_PRINTF("idx == %lu\n", idx);
-		switch(line[idx]) {
+		DEBUG_PRINTF("Switching on %d, `%c`\n", text[i], text[i]);
+		DEBUG_PRINTF("idx == %lu\n", i);
+		switch(text[i]) {
 		case '\0':
-			goto Refill;
+			*idx = i;
+			return O_EOF;
 			break;
 		/***** WHITESPACE *****/
 		case '\n':
 		case ' ':
 		case '\t':
-			++idx;
+			++i;
 			break;
 
 		/***** LITERALS *****/
+		/* Those that turn out not to be numbers, as `-` or `2DUP`, are
+		   words. Numbers in bases above ten that start with a letter are
+		   words too: `$FF` or `0FF` is a number, `FF` isn't. */
 		case '-':
+		case '$':
+		case '#':
+		case '%':
 		case '0':
 		case '1':
 		case '2':
@@ -141,136 +400,224 @@ start:
 		case '8':
 		case '9':
 			/* Parse number. */
-			readLength = readIntegral(line + idx, &ret, slot);
-			idx += readLength;
+			readLength = readIntegral(text + i, base, &ret, slot, tokens);
+			*idx = i + readLength;
 			return ret;
 			break;
 
 		case '"':
 			/* Parse string. */
-			readLength = readString(line + idx, &ret, slot);
-			idx += readLength;
+			readLength = readString(text + i, &ret, slot, tokens);
+			*idx = i + readLength;
 			return ret;
 			break;
 
-		/***** WORD DEFINITIONS *****/
-
-		case ':':
-			break;
-
-		case ';':
-			break;
-
 		/***** WORDS *****/
+		/* ':' and ';' are words too; Eval hands definitions to the compiler. */
 		default:
-			readLength = readWord(line + idx, &ret, slot);
-			idx += readLength;
+			readLength = readWord(text + i, &ret, slot, tokens);
+			*idx = i + readLength;
 			return ret;
 			break; }}
 }
 
-static enum object_type GetObj_OLD_(Object* slot) {
-	assert(slot);
+/* Gets a single lexeme-like entity from a stream, a line at a time. */
+static enum object_type GetObj_(void* ctx, Object* slot, unsigned base) {
+	struct GetObj* g = ctx;
+	enum object_type ret;
 
-	/* Store strings as they are constructed. */
-	Stack string_vect = alloca(StackSize());
-	string_vect = StackNew(string_vect, sizeof(char), NULL);
-	int c;
+	while (O_EOF == (ret = Scan(g->line, &g->idx, slot, &g->tokens, base))) {
+		Reset(&g->tokens);
+		g->idx = 0;
+		g->line[0] = '\0';
+		if (fpeek(g->stream) == EOF) return O_EOF;
+		fgets(g->line, sizeof(g->line)/sizeof(*g->line), g->stream); }
+	return ret;
+}
 
-	struct {
-		_Bool seen_nonwhite;
-		signed int vect_contents; // enum object_type, w/ -1
-	}state = {false, -1};
+/* Reads a block of the stream into `b`. */
+static void Fill(struct readAhead* a, struct block* b)
+{
+	b->n = fread(b->buf + MAX_CARRY, 1, BLOCK_SIZE, a->stream);
+	b->last = b->n < BLOCK_SIZE;
+}
 
-	for(;;) {
-	switch (c=fgetc(G_Stream)) {
-	/* 0-9: Number */
-	case '0':
-	case '1':
-	case '2':
-	case '3':
-	case '4':
-	case '5':
-	case '6':
-	case '7':
-	case '8':
-	case '9':
-		state.seen_nonwhite = true;
-		state.vect_contents = O_INTEGRAL;
-		StackPush(string_vect, &c);
-		break;
-	case '"':
-		state.seen_nonwhite = true;
-		if (O_STRING == state.vect_contents)
-			goto Return;
-		else state.vect_contents = O_STRING;
-		break;
-	/* Whitespce: End of token. */
-	case ' ': // fallthrough
-	case '\t':
-		if (O_STRING == state.vect_contents) {
-			StackPush(string_vect, &c);
-			break; }
-		// fallthrough
-	case '\n':
-		/* Skip whitespace until a token is seen. */
-		if(!state.seen_nonwhite)
-			break;
-		else /* Return interpretation of current token. */
-			goto Return;
-		break;
-	case EOF:
-		if (state.vect_contents == -1)
-			state.vect_contents = O_EOF;
-		goto Return;
-		break;
-	default:
-		state.seen_nonwhite = true;
-		if (state.vect_contents != O_STRING)
-			state.vect_contents = O_WORD;
-		StackPush(string_vect, &c);
-		break;
-	}}
-
-/* Token successfully parsed. Return it. */
-Return:
-	c = '\0';
-	StackPush(string_vect, &c);
-	switch (state.vect_contents) {
-	case O_INTEGRAL:
-		DEBUG_PRINT("GetObj_: Returning O_INTEGRAL.\n");
-		slot->integral = atoi(StackPeek(string_vect));
-		break;
-	case O_STRING:
-		DEBUG_PRINT("GetObj_: Returning O_STRING.\n");
-		slot->string = pstrdup(StackPeek(string_vect));
-		break;
-	case O_WORD:
-		DEBUG_PRINT("GetObj_: Returning O_WORD.\n");
-		slot->word = pstrdup(StackPeek(string_vect));
-		break;
-	case O_EOF:
-		break;
-	case O_ERROR:
-		fprintf(stderr, "O_ERROR: UNIMPLEMENTED\n");
-		/* TODO: Implement O_ERROR in GetObj */
-		break;
-	default:
-		fprintf(stderr,
-		        "BUG: Invalid value %d stored in vect_contents.\n",
-		        state.vect_contents);
-		break;
-	}
-	StackDelete(string_vect);
-	return state.vect_contents;
+/* Fills each block as the reader lets go of it. */
+static void* ReadAhead(void* va)
+{
+	struct readAhead* a = va;
+	for (unsigned k = 0;; k ^= 1) {
+		struct block* b = &a->blocks[k];
+		pthread_mutex_lock(&a->lock);
+		while (b->full && !a->stop) pthread_cond_wait(&a->changed, &a->lock);
+		const _Bool stop = a->stop;
+		pthread_mutex_unlock(&a->lock);
+		if (stop) break;
+
+		Fill(a, b);
+		pthread_mutex_lock(&a->lock);
+		b->full = true;
+		pthread_cond_broadcast(&a->changed);
+		pthread_mutex_unlock(&a->lock);
+		if (b->last) break; }
+	return NULL;
+}
+
+/* Moves on to the next block, carrying over the end of the current one,
+   which is then let go of. Returns false at the end of the stream. */
+static _Bool NextBlock(struct readAhead* a)
+{
+	struct block* b = &a->blocks[a->current];
+	const char* rest = NULL;
+	size_t carry = 0;
+	if (a->text) {
+		if (b->last) return false;
+		*a->cut = a->saved;
+		rest  = a->cut;
+		carry = (size_t)(b->buf + MAX_CARRY + b->n - a->cut);
+		a->current ^= 1; }
+
+	struct block* next = &a->blocks[a->current];
+	pthread_mutex_lock(&a->lock);
+	while (!next->full)
+		if (a->threaded) pthread_cond_wait(&a->changed, &a->lock);
+		else {
+			Fill(a, next);
+			next->full = true; }
+	pthread_mutex_unlock(&a->lock);
+
+	char* data = next->buf + MAX_CARRY;
+	if (carry) memcpy(data - carry, rest, carry);
+	if (a->text) {
+		pthread_mutex_lock(&a->lock);
+		b->full = false;
+		pthread_cond_broadcast(&a->changed);
+		pthread_mutex_unlock(&a->lock); }
+
+	/* Tokens, and strings, can't span lines, so the text ends at a line's
+	   end; what follows is carried over to the next block, if it fits in
+	   front of it. A longer line is split, as one without an end is. */
+	a->text = data - carry;
+	a->cut  = data + next->n;
+	if (!next->last) {
+		char* nl = a->cut;
+		while (nl > a->text && '\n' != nl[-1]) --nl;
+		if (nl > a->text) {
+			if ((size_t)(a->cut - nl) <= MAX_CARRY) a->cut = nl; }
+		else if (carry + next->n <= MAX_CARRY) a->cut = a->text; }
+	a->saved = *a->cut;
+	*a->cut  = '\0';
+	a->idx   = 0;
+	Reset(a->tokens);
+	return true;
 }
 
-/* Takes a FILE* and returns a function pointer to a GetObj. */
-/* Only one instance can be used at once, because there are no closures in C. */
-/* You could use a macro to implement them, however. */
-GetObjFN CreateGetObj(FILE* stream) {
+/* Gets a single lexeme-like entity from a stream, a block at a time. */
+static enum object_type GetObjBlock_(void* ctx, Object* slot, unsigned base) {
+	struct readAhead* a = ((struct GetObj*)ctx)->ahead;
+	enum object_type ret = O_EOF;
+
+	while (!a->text ||
+	       O_EOF == (ret = Scan(a->text, &a->idx, slot, a->tokens, base)))
+		if (!NextBlock(a)) return O_EOF;
+	return ret;
+}
+
+/* Sets `g` up to read blocks ahead. Returns false, for it to read lines
+   instead, on failed allocation. */
+static _Bool StartReadAhead(struct GetObj* g)
+{
+	struct readAhead* a = calloc(1, sizeof(*a));
+	if (!a) return false;
+	a->stream = g->stream;
+	a->tokens = &g->tokens;
+	if (!(a->blocks[0].buf = malloc(MAX_CARRY + BLOCK_SIZE + 1)) ||
+	    !(a->blocks[1].buf = malloc(MAX_CARRY + BLOCK_SIZE + 1)) ||
+	    pthread_mutex_init(&a->lock, NULL)) goto StartReadAhead_Free;
+	if (pthread_cond_init(&a->changed, NULL)) {
+		pthread_mutex_destroy(&a->lock);
+		goto StartReadAhead_Free; }
+
+	/* Without a thread, blocks are still read whole. */
+	a->threaded = !pthread_create(&a->filler, NULL, ReadAhead, a);
+	g->ahead = a;
+	return true;
+
+	/* ERROR BLOCK */
+StartReadAhead_Free:
+	free(a->blocks[0].buf);
+	free(a->blocks[1].buf);
+	free(a);
+	return false;
+}
+
+/* Gets a single lexeme-like entity from a string. */
+static enum object_type StringObj_(void* ctx, Object* slot, unsigned base) {
+	struct StringObj* s = ctx;
+	return Scan(s->text, &s->idx, slot, &s->tokens, base);
+}
+
+size_t GetObjSize(void) {
+	return sizeof(struct GetObj);
+}
+
+/* Takes a FILE* and returns a Reader of it, whose state is kept in `memory`. */
+Reader CreateGetObj(void* memory, FILE* stream) {
+	assert(memory);
 	assert(stream);
 
-	G_Stream = stream;
-	return GetObj_;
+	struct GetObj* g = memory;
+	g->stream  = stream;
+	g->line[0] = '\0';
+	g->idx     = 0;
+	g->ahead   = NULL;
+	g->tokens.used = 0;
+	g->tokens.big  = NULL;
+	/* Lines are only read one at a time when someone is typing them. */
+	if (!isatty(fileno(stream)) && StartReadAhead(g))
+		return (Reader){GetObjBlock_, g};
+	return (Reader){GetObj_, g};
+}
+
+void DeleteGetObj(void* memory) {
+	assert(memory);
+
+	struct GetObj* g = memory;
+	Reset(&g->tokens);
+	struct readAhead* a = g->ahead;
+	if (!a) return;
+	if (a->threaded) {
+		pthread_mutex_lock(&a->lock);
+		a->stop = true;
+		pthread_cond_broadcast(&a->changed);
+		pthread_mutex_unlock(&a->lock);
+		pthread_join(a->filler, NULL); }
+	pthread_cond_destroy(&a->changed);
+	pthread_mutex_destroy(&a->lock);
+	free(a->blocks[0].buf);
+	free(a->blocks[1].buf);
+	free(a);
+}
+
+size_t StringObjSize(void) {
+	return sizeof(struct StringObj);
+}
+
+/* Takes a NUL-terminated string and returns a Reader of it, whose state is
+   kept in `memory`. */
+Reader CreateStringObj(void* memory, const char* text) {
+	assert(memory);
+	assert(text);
+
+	struct StringObj* s = memory;
+	s->text   = text;
+	s->idx    = 0;
+	s->tokens.used = 0;
+	s->tokens.big  = NULL;
+	return (Reader){StringObj_, s};
+}
+
+void DeleteStringObj(void* memory) {
+	assert(memory);
+	Reset(&((struct StringObj*)memory)->tokens);
 }
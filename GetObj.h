@@ -4,10 +4,26 @@
 #include <stdio.h>
 #include "Eval.h"
 
-typedef enum object_type(*GetObjFN)(Object*);
+/* The text of the words and strings a reader returns is its own, and only
+   lasts until the next object is read from it. */
 
-/* Takes a FILE* and returns a function pointer to a GetObj. */
-/* Only one instance can be used at once, because there are no closures in C. */
-GetObjFN CreateGetObj(FILE* stream);
+/* The state of a reader of a FILE*: its stream, and the line being read. */
+size_t GetObjSize(void);
+
+/* Takes a FILE* and GetObjSize() bytes of memory for the reader's state,
+   which must outlive the reader, and returns a Reader of the stream. */
+/* A terminal is read a line at a time. Anything else is read in large
+   blocks, the next of which a thread reads while the last is tokenized. */
+Reader CreateGetObj(void* memory, FILE* stream);
+
+/* Stops reading ahead, and frees the reader's blocks. The stream is left
+   wherever reading ahead got to. */
+void DeleteGetObj(void* memory);
+
+/* As for a FILE*, but reads the NUL-terminated string `text`, which must
+   outlive the reader, returning O_EOF at its end. */
+size_t StringObjSize(void);
+Reader CreateStringObj(void* memory, const char* text);
+void DeleteStringObj(void* memory);
 
 #endif /* GETOBJ_H */
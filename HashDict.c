@@ -4,10 +4,12 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h> // size_t
+#include <limits.h> // ULONG_MAX
+#include <stdatomic.h>
+#include <pthread.h>
 
 #include "HashDict.h"
 #include "BitSet.h"
-#include "Alloca.h"
 #include "Assert.h"
 
 #define DEFAULT_NSLOTS 16
@@ -22,13 +24,37 @@
 
 /* Data structure representation. */
 
+/* Readers never lock: they find the pairs through `table`, which writers
+   replace with an updated copy, rather than change. A replaced table is
+   retired, then freed once no reader can still be looking at it, which is
+   told by epochs: each reader notes the epoch it started in, and each
+   retirement starts a new one. */
+
 // ~128 bytes in size, because of the composed BitSet member.
 // The BitSet helps substantially in reducing the memory usage of the buf.
-struct HashDict {
+struct table {
     /// Tracks which slots are in use and which are not.
     struct BitSet usedIndices;
     unsigned char* buf;
 
+    /// Number of slots currently allocated.
+    size_t nSlots;
+};
+
+/// A replaced table, and the pair a removal took out of it, if any.
+struct retired {
+    struct table* table;
+    unsigned char* pair; /* Freed, with {key,val}free, along with `table`. */
+    unsigned long epoch; /* The first epoch in which it was unreachable. */
+    struct retired* next;
+};
+
+struct HashDict {
+    _Atomic(struct table*) table;
+    pthread_mutex_t writing;    /* Held by writers, and by readers
+                                   for whom there was no `struct reader`. */
+    struct retired* retired;    /* Guarded by `writing`. */
+
 	_Bool (*keysEq) (const void* ep1, const void* ep2);
     size_t(*keyHash)(const void*);
     void  (*keyfree)(void*);
@@ -36,123 +62,242 @@ struct HashDict {
 
     size_t keysize;
     size_t valsize;
+};
 
-    /// Number of slots currently allocated.
-    size_t nSlots;
+/// A thread that reads dicts. Never freed, but reused once its thread exits.
+struct reader {
+    _Atomic unsigned long epoch; /* 0 outside of any read. */
+    unsigned depth;              /* Reads nest, as HashDictEach's visits. */
+    _Atomic _Bool used;
+    struct reader* next;
 };
 
+static _Atomic(struct reader*) Readers; /* Only ever pushed onto. */
+static _Atomic unsigned long Epoch = 1;
+static _Thread_local struct reader* Self;
+static pthread_key_t SelfKey;
+static pthread_once_t SelfOnce = PTHREAD_ONCE_INIT;
+
 /* TODO: Add appropriate casserts. */
 
 /* Helper macros. */
-#define VERIFY_CORRECT_BOUND(hd, idx)	              \
-	( (hd)->nSlots <= BitSetBound(&(hd)->usedIndices) )
-#define IN_RANGE(hd, idx)	                                              \
-	( ((idx) < BitSetBound(&(hd)->usedIndices)) && ((idx) < (hd)->nSlots) )
+#define VERIFY_CORRECT_BOUND(t, idx)	              \
+	( (t)->nSlots <= BitSetBound(&(t)->usedIndices) )
+#define IN_RANGE(t, idx)	                                              \
+	( ((idx) < BitSetBound(&(t)->usedIndices)) && ((idx) < (t)->nSlots) )
 /// Integral resize
 #define RESIZE(old_size) ((old_size) * RESIZE_FACTOR)
-#define KEYIDX(hd, idx) ( (hd)->buf + (idx)*((hd)->keysize+(hd)->valsize) )
-#define VALIDX(hd, idx) ( KEYIDX((hd), (idx)) + (hd)->keysize )
+#define PAIRSIZE(hd) ( (hd)->keysize + (hd)->valsize )
+#define KEYIDX(hd, t, idx) ( (t)->buf + (idx)*PAIRSIZE(hd) )
+#define VALIDX(hd, t, idx) ( KEYIDX((hd), (t), (idx)) + (hd)->keysize )
 
 /* Helper functions.
    - Helpers do not maintain class invariants, and therefore responsible use of them in the implementation of methods is expected.
    - Helpers with lowercase names impart no state changes. */
 
 /// Returns the index, (aka 'slot number') of a particular key.
-static inline size_t slotOf(const struct HashDict* hd, const void* key)
-{ return hd->keyHash(key) % hd->nSlots; }
-/* TODO: Add thread-safe optimization to slotOf, possibly by defining it
-   as a macro that calls an implementation, slotOf_. */
+static inline size_t slotOf(const struct HashDict* hd,
+                            const struct table* t, const void* key)
+{ return hd->keyHash(key) % t->nSlots; }
 
-/// Returns whether the slot `idx` of `hd` has a pair occupying it.
-static inline _Bool occupied(const struct HashDict* hd, size_t idx)
-{ iassert(IN_RANGE(hd, idx));
-    return BitSetHas(&hd->usedIndices, idx); }
+/// Returns whether the slot `idx` of `t` has a pair occupying it.
+static inline _Bool occupied(const struct table* t, size_t idx)
+{ iassert(IN_RANGE(t, idx));
+    return BitSetHas(&t->usedIndices, idx); }
 
-static inline _Bool Has(const struct HashDict* hd, const void* key, size_t idx)
+static inline _Bool Has(const struct HashDict* hd, const struct table* t,
+                        const void* key, size_t idx)
 {
-	return occupied(hd, idx) && hd->keysEq(key, KEYIDX(hd, idx));
+	return occupied(t, idx) && hd->keysEq(key, KEYIDX(hd, t, idx));
+}
+
+/// Returns whether the slot `idx` of `t` has a pair occupying it.
+static inline _Bool vacated(const struct table* t, size_t idx)
+{ return !occupied(t, idx); }
+
+/// Blindly set the slot `idx` of `t` as occupied.
+static inline void Occupy(struct table* t, size_t idx) {
+	iassert(IN_RANGE(t, idx) && ":( extension not explicit");
+	iassert(vacated(t, idx) && ":( `idx` already occupied");
+	BitSetAdd(&t->usedIndices, idx); }
+
+/// Blindly set the slot `idx` of `t` as unoccupied.
+static inline void Vacate(struct table* t, size_t idx) {
+	iassert(IN_RANGE(t, idx) && ":( `idx` larger than expected");
+	iassert(occupied(t, idx) && ":( `idx` already vacated");
+	BitSetRemove(&t->usedIndices, idx); }
+
+/// Blindly put the pair at `pair`, a key followed by its value, at `idx`.
+/// PREONDITION: t[idx] is in range; t[idx] is unoccupied.
+/// POSTCONDITION: t[idx] contains the pair, but is not marked occupied.
+/// NOTE: Leaves t in invalid state; to rectify, mark `idx` as occupied.
+static inline void PutAt(const struct HashDict* hd, struct table* t,
+                         const void* pair, size_t idx) {
+	iassert(IN_RANGE(t, idx));
+	iassert(vacated(t, idx));
+	memcpy(KEYIDX(hd, t, idx), pair, PAIRSIZE(hd)); }
+
+/// Blindly destruct the pair at `pair` using hd->{key,val}free.
+static inline void DeletePair(const struct HashDict* hd, unsigned char* pair) {
+	if (hd->keyfree) hd->keyfree(pair);
+	if (hd->valfree) hd->valfree(pair + hd->keysize);
+}
+
+/// Returns a new, empty table of `nSlots` slots, or NULL.
+static struct table* TableNew(const struct HashDict* hd, size_t nSlots) {
+	struct table* t = malloc(sizeof(*t));
+	sassert(t); // STRICT
+	if (!t) return NULL;
+
+	t->buf = malloc(nSlots * PAIRSIZE(hd));
+	sassert(t->buf); // STRICT
+	if (!t->buf) goto TableNew_FreeTable;
+
+	/* Initialize slot-tracking BitSet. */
+	if(!BitSetInit(&t->usedIndices, nSlots)) {
+		sassert(!("BitSetInit failed in TableNew.\n")); // STRICT
+		goto TableNew_FreeBuf; }
+	t->nSlots = nSlots;
+	return t;
+
+	/* ERROR BLOCK */
+TableNew_FreeBuf:
+	free(t->buf);
+TableNew_FreeTable:
+	free(t);
+	return NULL;
+}
+
+/// Frees `t`, but not the pairs in it, which other tables may hold.
+static void TableFree(struct table* t) {
+	BitSetDelete(&t->usedIndices);
+	free(t->buf);
+	free(t);
 }
 
-/// Returns whether the slot `idx` of `hd` has a pair occupying it.
-static inline _Bool vacated(const struct HashDict* hd, size_t idx)
-{ return !occupied(hd, idx); }
-
-/// Blindly set the slot `idx` of `hd` as occupied.
-static inline void Occupy(struct HashDict* hd, size_t idx) {
-	iassert(IN_RANGE(hd, idx) && ":( extension not explicit");
-	iassert(vacated(hd, idx) && ":( `idx` already occupied");
-	BitSetAdd(&hd->usedIndices, idx); }
-
-/// Blindly set the slot `idx` of `hd` as unoccupied.
-static inline void Vacate(struct HashDict* hd, size_t idx) {
-	iassert(IN_RANGE(hd, idx) && ":( `idx` larger than expected");
-	iassert(occupied(hd, idx) && ":( `idx` already vacated");
-	BitSetRemove(&hd->usedIndices, idx); }
-
-/// Blindly put `key` and `val` at the requested `idx` in buf.
-/// PREONDITION: hd[idx] is in range; hd[idx] is unoccupied.
-/// POSTCONDITION: hd[idx] contains (key,val), but is not marked occupied.
-/// NOTE: Leaves hd in invalid state; to rectify, mark `idx` as occupied.
-static inline void PutAt(struct HashDict* hd,
-                         const void* key, const void* val, size_t idx) {
-	iassert(IN_RANGE(hd, idx));
-	iassert(vacated(hd, idx));
-	memcpy(KEYIDX(hd, idx), key, hd->keysize);
-	memcpy(VALIDX(hd, idx), val, hd->valsize); }
-
-/// Blindly destruct (key,val) at hd[idx] using hd->{key,val}free.
-/// PRECONDITION: hd[idx] is in range; hd[idx] is occupied.
-/// POSTCONDITION: hd[idx] is safely reusable, but not marked unoccupied.
-/// NOTE: Places hd in invalid state; to rectify, mark `idx` as unoccupied.
-static inline void DeleteAt(struct HashDict* hd, size_t idx) {
-	iassert(IN_RANGE(hd, idx));
-	iassert(occupied(hd, idx));
-	if (hd->keyfree) hd->keyfree(KEYIDX(hd, idx));
-	if (hd->valfree) hd->valfree(VALIDX(hd, idx));
+/// Returns a copy of `t` with `nSlots` slots, or NULL on failed allocation,
+/// or if two of its pairs would share a slot.
+static struct table* Rehash(const struct HashDict* hd,
+                            const struct table* t, size_t nSlots) {
+	struct table* new = TableNew(hd, nSlots);
+	if (!new) return NULL;
+	for (size_t i = 0; i < t->nSlots; ++i)
+		if (occupied(t, i)) {
+			const size_t idx = slotOf(hd, new, KEYIDX(hd, t, i));
+			if (occupied(new, idx)) {
+				/// Failure to rehash: free resources, do not mutate t.
+				TableFree(new);
+				return NULL; }
+			PutAt(hd, new, KEYIDX(hd, t, i), idx);
+			Occupy(new, idx); }
+	return new;
 }
 
-/// Attempt to add an item without rehashing, returning true on success.
-/// POSTCONDITION: (key,val) put in hd[idx], hd[idx] marked occupied.
-/// NOTE: Invariants maintained.
-static inline _Bool TryAdd(struct HashDict* hd,
-                           const void* key, const void* val) {
-	iassert(IN_RANGE(hd, slotOf(hd, key)));
-	if (occupied(hd, slotOf(hd, key))) return false;
+/// Returns a copy of `t` in which the slot of `key` is free, rehashing it
+/// into more slots as need be, or NULL.
+static struct table* Extended(const struct HashDict* hd,
+                              const struct table* t, const void* key) {
+	size_t nSlots = t->nSlots;
+	for (unsigned rc = 0; rc <= REHASH_LIMIT; ++rc, nSlots = RESIZE(nSlots)) {
+		// Rehash fails when a pair already in `t` could not be added
+		// to the extended table, and thus the loop continues trying.
+		struct table* new = Rehash(hd, t, nSlots);
+		if (new && vacated(new, slotOf(hd, new, key))) return new;
+		if (new) TableFree(new); }
+	return NULL;
+}
+
+/// Puts `key` and `val` in the slot of `key`, which must be free.
+static void PutPair(const struct HashDict* hd, struct table* t,
+                    const void* key, const void* val) {
+	const size_t idx = slotOf(hd, t, key);
+	memcpy(KEYIDX(hd, t, idx), key, hd->keysize);
+	memcpy(VALIDX(hd, t, idx), val, hd->valsize);
+	Occupy(t, idx);
+}
+
+/* Readers: */
+static void Unregister(void* r) {
+	struct reader* self = r;
+	atomic_store(&self->epoch, 0);
+	atomic_store(&self->used, false);
+}
+
+static void CreateSelfKey(void)
+{ pthread_key_create(&SelfKey, Unregister); }
+
+/// Returns this thread's reader, reusing that of one that exited, or NULL.
+static struct reader* Register(void) {
+	struct reader* r;
+	pthread_once(&SelfOnce, CreateSelfKey);
+	for (r = atomic_load(&Readers); r; r = r->next) {
+		_Bool unused = false;
+		if (atomic_compare_exchange_strong(&r->used, &unused, true)) break; }
+	if (!r) {
+		if (!(r = malloc(sizeof(*r)))) return NULL;
+		atomic_init(&r->epoch, 0);
+		atomic_init(&r->used, true);
+		r->next = atomic_load(&Readers);
+		while (!atomic_compare_exchange_weak(&Readers, &r->next, r)); }
+	r->depth = 0;
+	pthread_setspecific(SelfKey, r);
+	return r;
+}
 
-	PutAt(hd, key, val, slotOf(hd, key));
-	Occupy(hd, slotOf(hd, key));
+/// Starts a read of `hd`, after which its table is safe to use.
+/// Returns false if `hd` had to be locked instead, for want of memory.
+static _Bool Enter(const struct HashDict* hd) {
+	if (!Self && !(Self = Register())) {
+		pthread_mutex_lock((pthread_mutex_t*)&hd->writing);
+		return false; }
+	/* A table loaded after this store can't be freed before Leave. */
+	if (!Self->depth++) atomic_store(&Self->epoch, atomic_load(&Epoch));
 	return true;
 }
-static _Bool TryRehash(struct HashDict* hd, size_t* nSlots) {
-//	DEBUG_PRINTF("Rehashing!\n");
-	*nSlots = RESIZE(*nSlots);
-
-	struct HashDict* restrict new;
-	PALLOCA(new, sizeof(struct HashDict));
-	new = HashDictNew(new, *nSlots,
-	                  hd->keysize, hd->valsize,
-	                  hd->keyHash,
-	                  hd->keysEq,
-	                  hd->keyfree, hd->valfree);
-	sassert(new); // STRICT
-	if (!new) return false;
-
-	for (size_t i = 0; i < hd->nSlots; ++i)
-		if (occupied(hd, i)) {
-			if (!TryAdd(new, KEYIDX(hd, i), VALIDX(hd, i))) {
-				/// Failure to rehash: free resources, do not mutate hd.
-				new->keyfree = NULL;
-				new->valfree = NULL;
-				HashDictDelete(new);
-				return false; }}
-	/* Successful rehash.
-	   Free all buffers in hd, but avoid calling {key,val}free. */
-	hd->keyfree = NULL;
-	hd->valfree = NULL;
-	HashDictDelete(hd);
-
-	/* Populate hd. */
-	memcpy(hd, new, HashDictSize());
+
+static void Leave(const struct HashDict* hd, _Bool entered) {
+	if (!entered) {
+		pthread_mutex_unlock((pthread_mutex_t*)&hd->writing);
+		return; }
+	if (!--Self->depth) atomic_store(&Self->epoch, 0);
+}
+
+/* Writers, which hold hd->writing: */
+/// Frees what was retired before the earliest epoch a reader is in.
+static void Reclaim(struct HashDict* hd) {
+	unsigned long oldest = ULONG_MAX;
+	for (struct reader* r = atomic_load(&Readers); r; r = r->next) {
+		const unsigned long epoch = atomic_load(&r->epoch);
+		if (epoch && epoch < oldest) oldest = epoch; }
+
+	for (struct retired** p = &hd->retired; *p; ) {
+		struct retired* old = *p;
+		if (old->epoch > oldest) {
+			p = &old->next;
+			continue; }
+		*p = old->next;
+		if (old->pair) {
+			DeletePair(hd, old->pair);
+			free(old->pair); }
+		TableFree(old->table);
+		free(old); }
+}
+
+/// Makes `new` the table, retiring the old one, along with `pair`, if any.
+/// Returns false, changing nothing, on failed allocation.
+static _Bool Publish(struct HashDict* hd, struct table* new,
+                     unsigned char* pair) {
+	struct retired* old = malloc(sizeof(*old));
+	sassert(old); // STRICT
+	if (!old) return false;
+
+	old->table = atomic_exchange(&hd->table, new);
+	old->pair  = pair;
+	/* Readers that start from now on can only find `new`. */
+	old->epoch = atomic_fetch_add(&Epoch, 1) + 1;
+	old->next  = hd->retired;
+	hd->retired = old;
+	Reclaim(hd);
 	return true;
 }
 
@@ -182,6 +327,11 @@ _Bool cstrcEq(const void* svp1, const void* svp2) {
 	return !strcmp(cstr1, cstr2);
 }
 
+/* Frees a string key or value. */
+void cstrcfree(void* v) {
+	free(*(char**)v);
+}
+
 /********** Method implementations. **********/
 
 size_t HashDictSize(void)
@@ -209,17 +359,6 @@ HashDict HashDictNew(void * memory, size_t nSlots,
 
 	struct HashDict* hdict = memory;
 
-	/* Allocate buffer. */
-	hdict->buf = malloc(nSlots * (keysize + valsize));
-	sassert(hdict->buf); // STRICT
-	if (!hdict->buf) return NULL;
-
-	/* Initialize slot-tracking BitSet. */
-	if(!BitSetInit(&hdict->usedIndices, nSlots)) {
-		sassert(!("BitSetInit failed in HashDict__New.\n")); // STRICT
-		free(hdict->buf);
-		return NULL; }
-
 	/* Initialize local variables. */
 	hdict->keyfree = keyfree;
 	hdict->valfree = valfree;
@@ -228,7 +367,15 @@ HashDict HashDictNew(void * memory, size_t nSlots,
 
 	hdict->keyHash = keyHash;
 	hdict->keysEq  = keysEq;
-	hdict->nSlots  = nSlots;
+	hdict->retired = NULL;
+
+	/* Allocate the first table. */
+	struct table* t = TableNew(hdict, nSlots);
+	if (!t) return NULL;
+	if (pthread_mutex_init(&hdict->writing, NULL)) {
+		TableFree(t);
+		return NULL; }
+	atomic_init(&hdict->table, t);
 
 	return hdict;
 }
@@ -245,20 +392,20 @@ _Bool HashDictAdd(struct HashDict* hd, const void* key, const void* val) {
 	cassert(val);
 	if (!hd) return false;
 
-	// TODO: Check if Has, and return false on Has (because ownership wasn't taken)
-	// TODO: Recalculate the modulo, rather than calling slotOf each iteration.
-
-	unsigned rc; // Rehash count
-	size_t hdSlots = hd->nSlots; // Holds state for TryRehash retries.
-	for (rc = 0; rc <= REHASH_LIMIT && occupied(hd, slotOf(hd,key)); ++rc) {
-	/* "While TryRehash fails and we are still under the hash limit,
-	   say that we have attempted to hash one more time." */
-		while(!TryRehash(hd, &hdSlots) && rc < REHASH_LIMIT) ++rc;}
-	// Note that TryRehash fails when a value already in hd could not
-	// be re-added to the extended `hd`, and thus the loop to continue
-	// trying, whereas the outer for loop continues to re-attempt if
-	// `val` could not be added.
-	return TryAdd(hd, key, val);
+	_Bool added = false;
+	pthread_mutex_lock(&hd->writing);
+	const struct table* t = atomic_load(&hd->table);
+	/* Ownership isn't taken of a key that's already present. */
+	if (Has(hd, t, key, slotOf(hd, t, key))) goto HashDictAdd_Unlock;
+
+	struct table* new = Extended(hd, t, key);
+	if (!new) goto HashDictAdd_Unlock;
+	PutPair(hd, new, key, val);
+	if (!(added = Publish(hd, new, NULL))) TableFree(new);
+
+HashDictAdd_Unlock:
+	pthread_mutex_unlock(&hd->writing);
+	return added;
 }
 
 void HashDictRemove(struct HashDict* hd, const void* key)
@@ -267,10 +414,69 @@ void HashDictRemove(struct HashDict* hd, const void* key)
 	cassert(key);
 	if (!hd) return;
 
-	if (HashDictHas(hd, key)) {
-		DeleteAt(hd, slotOf(hd,key));
-		Vacate(hd, slotOf(hd,key)); }
+	pthread_mutex_lock(&hd->writing);
+	const struct table* t = atomic_load(&hd->table);
+	const size_t idx = slotOf(hd, t, key);
+	if (!Has(hd, t, key, idx)) goto HashDictRemove_Unlock;
+
+	/* The pair is freed once no reader can have found it. */
+	unsigned char* pair = malloc(PAIRSIZE(hd));
+	struct table* new = Rehash(hd, t, t->nSlots);
+	sassert(pair && new); // STRICT
+	if (!pair || !new) goto HashDictRemove_Fail;
+	memcpy(pair, KEYIDX(hd, t, idx), PAIRSIZE(hd));
+	Vacate(new, idx);
+	if (!Publish(hd, new, pair)) goto HashDictRemove_Fail;
+
+HashDictRemove_Unlock:
+	pthread_mutex_unlock(&hd->writing);
+	return;
+
+	/* ERROR BLOCK */
+HashDictRemove_Fail:
+	free(pair);
+	if (new) TableFree(new);
+	goto HashDictRemove_Unlock;
 }
+
+_Bool HashDictReplace(struct HashDict* hd, const void* key, const void* val)
+{
+	sassert(hd); // STRICT
+	cassert(key);
+	cassert(val);
+	if (!hd) return false;
+
+	_Bool replaced = false;
+	pthread_mutex_lock(&hd->writing);
+	const struct table* t = atomic_load(&hd->table);
+	const size_t idx = slotOf(hd, t, key);
+	unsigned char* pair = NULL;
+	struct table* new = NULL;
+	if (!Has(hd, t, key, idx)) {
+		if (!(new = Extended(hd, t, key))) goto HashDictReplace_Unlock; }
+	else {
+		/* The old pair is freed once no reader can have found it. */
+		pair = malloc(PAIRSIZE(hd));
+		new = Rehash(hd, t, t->nSlots);
+		sassert(pair && new); // STRICT
+		if (!pair || !new) goto HashDictReplace_Fail;
+		memcpy(pair, KEYIDX(hd, t, idx), PAIRSIZE(hd));
+		Vacate(new, idx); }
+	PutPair(hd, new, key, val);
+	/* One publish: readers find either the old pair or the new one. */
+	if (!(replaced = Publish(hd, new, pair))) goto HashDictReplace_Fail;
+
+HashDictReplace_Unlock:
+	pthread_mutex_unlock(&hd->writing);
+	return replaced;
+
+	/* ERROR BLOCK */
+HashDictReplace_Fail:
+	free(pair);
+	if (new) TableFree(new);
+	goto HashDictReplace_Unlock;
+}
+
 _Bool HashDictGet(const struct HashDict* hd, const void* key,
 		  /* valSlot may be NULL. */
 		  void* valSlot) {
@@ -278,20 +484,35 @@ _Bool HashDictGet(const struct HashDict* hd, const void* key,
 	cassert(key);
 	if (!hd) return false;
 
-	if (HashDictHas(hd, key)) {
-		if (valSlot)
-			memcpy(valSlot, VALIDX(hd, slotOf(hd,key)), hd->valsize);
-		return true; }
-	return false;
+	const _Bool entered = Enter(hd);
+	const struct table* t = atomic_load(&hd->table);
+	const size_t idx = slotOf(hd, t, key);
+	const _Bool has = Has(hd, t, key, idx);
+	if (has && valSlot)
+		memcpy(valSlot, VALIDX(hd, t, idx), hd->valsize);
+	Leave(hd, entered);
+	return has;
 }
 
 _Bool HashDictHas(const struct HashDict* hd, const void* key)
+{
+	return HashDictGet(hd, key, NULL);
+}
+
+void HashDictEach(const struct HashDict* hd,
+                  void (*visit)(const void* key, const void* val, void* ctx),
+                  void* ctx)
 {
 	sassert(hd); // STRICT
-	cassert(key);
-	if (!key) return false;
+	cassert(visit);
+	if (!hd) return;
 
-	return Has(hd, key, slotOf(hd, key));
+	const _Bool entered = Enter(hd);
+	const struct table* t = atomic_load(&hd->table);
+	for (size_t idx = 0; idx < t->nSlots; ++idx)
+		if (occupied(t, idx))
+			visit(KEYIDX(hd, t, idx), VALIDX(hd, t, idx), ctx);
+	Leave(hd, entered);
 }
 
 void HashDictDelete(struct HashDict* hd)
@@ -299,14 +520,25 @@ void HashDictDelete(struct HashDict* hd)
 	sassert(hd); // STRICT
 	if (!hd) return;
 
+	/* Nothing can be reading by now. */
+	struct table* t = atomic_load(&hd->table);
+	while (hd->retired) {
+		struct retired* old = hd->retired;
+		hd->retired = old->next;
+		if (old->pair) {
+			DeletePair(hd, old->pair);
+			free(old->pair); }
+		TableFree(old->table);
+		free(old); }
+
 	/* Optimization: Skip looping if member destructors aren't defined. */
 	if (!hd->keyfree && !hd->valfree) goto hdd_DestructMembers;
 
 	/* Destruct elements that are still owned. */
-	for (size_t idx = 0; idx < hd->nSlots; ++idx)
-		if (occupied(hd, idx))
-			DeleteAt(hd, idx);
+	for (size_t idx = 0; idx < t->nSlots; ++idx)
+		if (occupied(t, idx))
+			DeletePair(hd, KEYIDX(hd, t, idx));
 hdd_DestructMembers:
-	BitSetDelete(&hd->usedIndices);
-	free(hd->buf);
+	TableFree(t);
+	pthread_mutex_destroy(&hd->writing);
 }
@@ -3,6 +3,11 @@
 
 typedef struct HashDict* HashDict;
 
+/* Get, Has and Each may run on any number of threads at once, alongside
+   Add, Remove and Replace, without locking: writers publish an updated copy
+   of the table, and free the old one once no reader can still be using it. */
+/* Writes copy the whole table, so suit dicts that are mostly read. */
+
 #define HASHDICT_METHOD_(pref, method_name) pref ## method_name
 #define HASHDICT_METHOD__(pref, method_name) HASHDICT_METHOD_(pref, method_name)
 #define HASHDICT_METHOD(method_name)	          \
@@ -10,6 +15,7 @@ typedef struct HashDict* HashDict;
 
 unsigned long cstrcSimpleHash(const void* vps);
 _Bool cstrcEq(const void* svp1, const void* svp2);
+void cstrcfree(void* v);
 
 size_t HashDictSize(void);
 HashDict HashDictNew(void* memory, size_t nSlots,
@@ -21,10 +27,16 @@ HashDict HashDictNew(void* memory, size_t nSlots,
 
 _Bool HashDictAdd(struct HashDict* hd, const void* key, const void* val);
 void HashDictRemove(struct HashDict* hd, const void* key);
+/* As Remove then Add, but readers never see `key` missing in between. */
+_Bool HashDictReplace(struct HashDict* hd, const void* key, const void* val);
 _Bool HashDictGet(const struct HashDict* hd, const void* key,
                   /* valSlot may be NULL. */
                   void* valSlot);
 _Bool HashDictHas(const struct HashDict* hd, const void* key);
+/* Calls `visit` on every pair, in no particular order. */
+void HashDictEach(const struct HashDict* hd,
+                  void (*visit)(const void* key, const void* val, void* ctx),
+                  void* ctx);
 void HashDictDelete(struct HashDict* hd);
 
 #ifdef HASHDICT_PREFIX
@@ -45,12 +57,20 @@ static _Bool (* const HASHDICT_METHOD(Add))(struct HashDict* hd,
                                             const void* val) = HashDictAdd;
 static void (* const HASHDICT_METHOD(Remove))(struct HashDict* hd,
                                               const void* key) = HashDictRemove;
+static _Bool (* const HASHDICT_METHOD(Replace))(struct HashDict* hd,
+                                                const void* key,
+                                                const void* val) = HashDictReplace;
 static _Bool (* const HASHDICT_METHOD(Get))(const struct HashDict* hd,
                                             const void* key,
                                             /* valSlot may be NULL. */
                                             void* valSlot) = HashDictGet;
 static _Bool (* const HASHDICT_METHOD(Has))(const struct HashDict* hd,
                                             const void* key) = HashDictHas;
+static void (* const HASHDICT_METHOD(Each))(const struct HashDict* hd,
+                                            void (*visit)(const void* key,
+                                                          const void* val,
+                                                          void* ctx),
+                                            void* ctx) = HashDictEach;
 static void (* const HASHDICT_METHOD(Delete))(struct HashDict* hd) = HashDictDelete;
 #endif /* HASHDICT_PREFIX */
 
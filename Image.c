@@ -0,0 +1,730 @@
+#include <stdio.h>
+#include <stdlib.h> // malloc, free, qsort, bsearch, mkstemp
+#include <string.h> // memcpy, memcmp, memset, strlen
+#include <stdint.h>
+#include <stdbool.h>
+#include <fcntl.h>    // open
+#include <unistd.h>   // close
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat, fchmod
+
+#include "Dict.h"
+#include "Assert.h"
+#include "ForthTypes.h"
+#include "Definition.h"
+#include "ForthString.h"
+#include "Builtins.h"
+#include "Image.h"
+#include "Session.h"
+#include "DataSpace.h"
+
+#include "Debug.h"
+#include "Strdup.h"
+
+/*
+ * An image holds compiled definitions in the very layout Execute runs them
+ * in, so that loading one is a matter of mapping it and patching pointers.
+ *
+ * Layout:      header | definition table | symbol table | records | strings
+ *              | data space
+ *
+ * Records are struct Definitions. Wherever their code holds a pointer,
+ * the image holds an offset from its start instead:
+ *   I_CALL of a F_COMPILED word: the offset of the callee's record.
+ *   I_CALL of a F_BUILTIN word:  an index into the symbol table,
+ *                                naming a builtin or a word defined
+ *                                before the image was loaded.
+ *   I_STRING:                    the offset of the string's text,
+ *                                behind a struct StringHead that
+ *                                marks it STRING_STATIC; short ones
+ *                                are kept as they are, in place.
+ *   I_CREATE:                    the offset of the created word's record,
+ *                                which must be written too.
+ * The data space, if saved, is what had been allotted, byte for byte; its
+ * addresses, being offsets, hold as long as it's loaded into an empty one.
+ * Images are specific to the machine and the build that wrote them;
+ * IMAGE_VERSION must be bumped whenever the instruction set changes.
+ */
+
+#define IMAGE_MAGIC   "4THIMAGE"
+#define IMAGE_VERSION 8
+#define ALIGN(n) ( ((n) + 7) & ~(uint64_t)7 )
+
+struct header {
+	char     magic[8];
+	uint32_t version;
+	uint32_t instruction_size;
+	uint64_t hash;
+	uint64_t size;          /* Of the whole file, so as to catch truncation. */
+	uint64_t program;       /* Offset of the program's record; 0 if none.     */
+	uint64_t definitions;   /* Offset of the table of struct entry.           */
+	uint64_t n_definitions;
+	uint64_t symbols;       /* Offset of the table of struct symbol.          */
+	uint64_t n_symbols;
+	uint64_t data;          /* Offset of the data space's bytes; 0 if none.  */
+	uint64_t n_data;
+};
+
+struct entry {
+	uint64_t record; /* Offset of a struct Definition.  */
+	uint64_t name;   /* Offset of its name; 0 if none.  */
+};
+
+/* Symbols are resolved by name: builtins through the builtin table,
+   words through the namespace the image is loaded into. */
+enum symbol_kind { S_BUILTIN, S_WORD };
+struct symbol {
+	uint64_t name; /* Offset of the name. */
+	uint64_t kind; /* enum symbol_kind.   */
+};
+
+/* Where each written definition's record goes. */
+struct placement {
+	const struct Definition* def;
+	uint64_t record;
+};
+
+/* Growable byte buffer. */
+struct buffer {
+	char*  bytes;
+	size_t n;
+	size_t allocated;
+};
+
+/********** PRIVATE: UTILITY FUNCTIONS **********/
+static _Bool Append(struct buffer* b, const void* bytes, size_t n)
+{
+	if (b->n + n > b->allocated) {
+		size_t allocated = b->allocated ? b->allocated : 256;
+		while (allocated < b->n + n) allocated *= 2;
+		char* ptr = realloc(b->bytes, allocated);
+		if (!ptr) return false;
+		b->bytes = ptr;
+		b->allocated = allocated; }
+	memcpy(b->bytes + b->n, bytes, n);
+	b->n += n;
+	return true;
+}
+
+/* Operands are stored in the leading bytes of an instruction's `data`. */
+static inline void SetOperand(Instruction* in, uint64_t operand)
+{
+	memcpy(&in->data, &operand, sizeof(operand));
+}
+
+static inline uint64_t GetOperand(const Instruction* in)
+{
+	uint64_t operand;
+	memcpy(&operand, &in->data, sizeof(operand));
+	return operand;
+}
+
+static inline uint64_t RecordSize(unsigned long length)
+{
+	return ALIGN(sizeof(struct Definition) + length * sizeof(Instruction));
+}
+
+static int ComparePlacements(const void* vp1, const void* vp2)
+{
+	const uintptr_t p1 = (uintptr_t) ((const struct placement*)vp1)->def;
+	const uintptr_t p2 = (uintptr_t) ((const struct placement*)vp2)->def;
+	return (p1 > p2) - (p1 < p2);
+}
+
+static int CompareOffsets(const void* vp1, const void* vp2)
+{
+	const uint64_t o1 = *(const uint64_t*)vp1;
+	const uint64_t o2 = *(const uint64_t*)vp2;
+	return (o1 > o2) - (o1 < o2);
+}
+
+static inline _Bool SameWord(ForthWord w1, ForthWord w2)
+{
+	if (w1.type != w2.type) return false;
+	if (F_BUILTIN == w1.type) return w1.data.builtin == w2.data.builtin;
+	return w1.data.compiled == w2.data.compiled;
+}
+
+/* Returns the index of `word` in `symbols`, adding it if needed. */
+/* Returns -1 on failed allocation. */
+static long SymbolOf(struct buffer* symbols, ForthWord word)
+{
+	const ForthWord* syms = (const ForthWord*)symbols->bytes;
+	const size_t n = symbols->n / sizeof(ForthWord);
+	for (size_t i = 0; i < n; ++i)
+		if (SameWord(syms[i], word)) return (long)i;
+	if (!Append(symbols, &word, sizeof(word))) return -1;
+	return (long)n;
+}
+
+static int CompareNamed(const void* vp1, const void* vp2)
+{
+	const uintptr_t p1 = (uintptr_t) ((const struct NamedDefinition*)vp1)->def;
+	const uintptr_t p2 = (uintptr_t) ((const struct NamedDefinition*)vp2)->def;
+	return (p1 > p2) - (p1 < p2);
+}
+
+/* DictEach visitor gathering a namespace's compiled words, save for those
+   shadowed by `over` (which can be NULL). */
+struct gather { struct buffer b; Dict over; };
+static void GatherNamed(const void* key, const void* val, void* ctx)
+{
+	const ForthWord* fw = val;
+	struct gather* g = ctx;
+	if (F_COMPILED != fw->type || (g->over && DictHas(g->over, key))) return;
+	struct NamedDefinition nd = {*(char* const*)key, fw->data.compiled};
+	if (!Append(&g->b, &nd, sizeof(nd)))
+		g->b.allocated = SIZE_MAX; /* Marks the failure. */
+}
+
+/* Sets `*named` to a sorted array of the `*n` compiled words visible to
+   `state` (which can be NULL), whose names remain owned by its namespaces. */
+/* Returns false on failed allocation. */
+static _Bool Named(const struct State* state,
+                   struct NamedDefinition** named, size_t* n)
+{
+	struct gather g = {{NULL, 0, 0}, NULL};
+	if (state) {
+		DictEach(state->namespace, GatherNamed, &g);
+		g.over = state->namespace;
+		if (state->shared) DictEach(state->shared, GatherNamed, &g); }
+	struct buffer b = g.b;
+	if (SIZE_MAX == b.allocated) {
+		free(b.bytes);
+		return false; }
+	*n = b.n / sizeof(struct NamedDefinition);
+	if (*n) qsort(b.bytes, *n, sizeof(struct NamedDefinition), CompareNamed);
+	*named = (struct NamedDefinition*)b.bytes;
+	return true;
+}
+
+/* Returns the name a symbol is resolved by, or NULL if it has none. */
+static const char* SymbolName(ForthWord word,
+                              const struct NamedDefinition* named, size_t n)
+{
+	if (F_BUILTIN == word.type) return BuiltinName(word.data.builtin);
+	struct NamedDefinition key = {NULL, word.data.compiled};
+	const struct NamedDefinition* nd =
+		n ? bsearch(&key, named, n, sizeof(*nd), CompareNamed) : NULL;
+	return nd ? nd->name : NULL;
+}
+
+/* Appends a string to `strings`, returning its offset in the image. */
+/* Returns 0 on failed allocation. */
+static uint64_t StringOf(struct buffer* strings, uint64_t base, const char* s)
+{
+	const uint64_t offset = base + strings->n;
+	if (!Append(strings, s, strlen(s) + 1)) return 0;
+	return offset;
+}
+
+/* Appends a string literal to `strings`, as one that nothing owns, returning
+   the offset of its text in the image. Returns 0 on failed allocation. */
+static uint64_t LiteralOf(struct buffer* strings, uint64_t base,
+                          ForthDatum s)
+{
+	static const char padding[8];
+	struct StringHead head;
+	memset(&head, 0, sizeof(head));
+	head.refs   = STRING_STATIC;
+	head.length = StringLength(s);
+	if (!Append(strings, padding, ALIGN(strings->n) - strings->n) ||
+	    !Append(strings, &head, sizeof(head))) return 0;
+	const uint64_t offset = base + strings->n;
+	if (!Append(strings, s.String, head.length + 1)) return 0;
+	return offset;
+}
+
+/* Appends `def`'s record to `records`, with pointers made into offsets. */
+static _Bool WriteRecord(struct buffer* records, struct buffer* strings,
+                         uint64_t stringBase,
+                         const struct Definition* def,
+                         const struct placement* placements, size_t n,
+                         const struct buffer* symbols /* Already complete. */)
+{
+	struct Definition head;
+	memset(&head, 0, sizeof(head));
+	head.refs    = DEFINITION_STATIC;
+	head.length  = def->length;
+	head.created = def->created;
+	if (!Append(records, &head, sizeof(head))) return false;
+
+	for (unsigned long i = 0; i < def->length; ++i) {
+		const Instruction* in = &def->code[i];
+		Instruction out;
+		memset(&out, 0, sizeof(out));
+		out.type = in->type;
+		switch (in->type) {
+		case I_CALL:
+			if (F_COMPILED == in->data.word.type) {
+				struct placement key = {in->data.word.data.compiled, 0};
+				const struct placement* p =
+					bsearch(&key, placements, n, sizeof(*p), ComparePlacements);
+				if (p) {
+					out.data.word.type = F_COMPILED;
+					SetOperand(&out, p->record);
+					break; }}
+			/* Not among those written: refer to it by name. */
+			out.data.word.type = F_BUILTIN;
+			SetOperand(&out, (uint64_t)SymbolOf((struct buffer*)symbols,
+			                                    in->data.word));
+			break;
+		case I_STRING: {
+			if (StringIsShort(in->data.String)) {
+				out.data.String = in->data.String;
+				break; }
+			const uint64_t offset = LiteralOf(strings, stringBase,
+			                                  in->data.String);
+			if (!offset) return false;
+			SetOperand(&out, offset);
+		} break;
+		case I_CREATE: {
+			struct placement key = {in->data.word.data.compiled, 0};
+			const struct placement* p =
+				bsearch(&key, placements, n, sizeof(*p), ComparePlacements);
+			if (!p) {
+				DEBUG_PRINT("ImageWrite: CREATE of a word not written.\n");
+				return false; }
+			out.data.word.type = F_COMPILED;
+			SetOperand(&out, p->record);
+		} break;
+		default:
+			out.data.Int = in->data.Int;
+			break; }
+		if (!Append(records, &out, sizeof(out))) return false; }
+
+	static const char padding[8];
+	const size_t written = sizeof(head) + def->length * sizeof(Instruction);
+	return Append(records, padding, RecordSize(def->length) - written);
+}
+
+/* Returns the record at `offset` in the mapped image, or NULL if the offset
+   doesn't designate one that fits. */
+static struct Definition* RecordAt(char* base, size_t size, uint64_t offset)
+{
+	if (offset % 8 || offset > size ||
+	    size - offset < sizeof(struct Definition)) return NULL;
+	struct Definition* def = (struct Definition*)(base + offset);
+	if (DEFINITION_STATIC != def->refs || !def->length ||
+	    def->length > (size - offset - sizeof(struct Definition))
+	                  / sizeof(Instruction)) return NULL;
+	return def;
+}
+
+/* Returns the NUL-terminated string at `offset`, or NULL if there's none. */
+static const char* StringAt(const char* base, size_t size, uint64_t offset)
+{
+	if (!offset || offset >= size) return NULL;
+	if (!memchr(base + offset, '\0', size - offset)) return NULL;
+	return base + offset;
+}
+
+/* Returns the text of the string literal at `offset`, or NULL if there's
+   none. */
+static const char* LiteralAt(const char* base, size_t size, uint64_t offset)
+{
+	if (offset % 8 || offset < sizeof(struct StringHead) || offset >= size)
+		return NULL;
+	const struct StringHead* head =
+		(const struct StringHead*)(base + offset) - 1;
+	if (STRING_STATIC != head->refs || head->length >= size - offset ||
+	    base[offset + head->length]) return NULL;
+	return base + offset;
+}
+
+/* Turns the offsets in a mapped record back into pointers. */
+/* `records` holds the sorted offsets of all records in the image. */
+static _Bool Relocate(char* base, size_t size, struct Definition* def,
+                      const uint64_t* records, size_t nRecords,
+                      const ForthWord* symbols, size_t nSymbols)
+{
+	for (unsigned long i = 0; i < def->length; ++i) {
+		Instruction* in = &def->code[i];
+		const uint64_t operand = GetOperand(in);
+		switch (in->type) {
+		case I_CALL:
+			if (F_COMPILED == in->data.word.type) {
+				if (!bsearch(&operand, records, nRecords, sizeof(*records),
+				             CompareOffsets)) return false;
+				in->data.word.data.compiled = (struct Definition*)(base + operand);
+			} else if (F_BUILTIN == in->data.word.type && operand < nSymbols)
+				in->data.word = symbols[operand]; /* Held by the ImageMap. */
+			else return false;
+			break;
+		case I_STRING:
+			/* Short strings are kept in place, and must end there. */
+			if (StringIsShort(in->data.String)) {
+				const size_t length = StringLength(in->data.String);
+				if (length > STRING_SHORT ||
+				    StringText(&in->data.String)[length]) return false; }
+			else if (!(in->data.String.String =
+			           LiteralAt(base, size, operand))) return false;
+			break;
+		case I_CREATE: {
+			/* The created word's first instruction is what it sets. */
+			const struct Definition* word = RecordAt(base, size, operand);
+			if (F_COMPILED != in->data.word.type || !word ||
+			    !bsearch(&operand, records, nRecords, sizeof(*records),
+			             CompareOffsets) ||
+			    !word->created || I_INT != word->code[0].type) return false;
+			in->data.word.data.compiled = (struct Definition*)(base + operand);
+		} break;
+		case I_BRANCH:
+		case I_BRANCH0:
+		case I_QDO:
+		case I_LOOP:
+		case I_PLUSLOOP:
+			/* Branches must stay within the definition. */
+			if (in->data.offset < -(long)i ||
+			    in->data.offset >= (long)(def->length - i)) return false;
+			break;
+		case I_PARDO:
+			/* The body's I_EXIT, then the combining I_CALL, precede the target. */
+			if (in->data.offset < 3 ||
+			    in->data.offset >= (long)(def->length - i) ||
+			    I_EXIT != in[in->data.offset - 2].type ||
+			    I_CALL != in[in->data.offset - 1].type) return false;
+			break;
+		case I_INT:
+		case I_FLOAT:
+		case I_DO:
+		case I_UNLOOP:
+		case I_INDEX:
+		case I_LOCALS:
+		case I_LOCAL:
+		case I_TO:
+		case I_ENDLOCALS:
+		case I_EXIT:
+			break;
+		default:
+			return false; }}
+	/* Execution must not run off the end. */
+	return I_EXIT == def->code[def->length - 1].type;
+}
+
+/* As ImageWrite, followed by what `data` (which can be NULL) has allotted. */
+static _Bool Write(const char* path, uint64_t hash, const struct State* state,
+                   const struct Definition* program,
+                   const struct NamedDefinition* defs, size_t n,
+                   const DataSpace data)
+{
+	_Bool ok = false;
+	struct buffer records = {NULL, 0, 0};
+	struct buffer strings = {NULL, 0, 0};
+	struct buffer symbols = {NULL, 0, 0};
+	struct NamedDefinition* named = NULL;
+	size_t nNamed = 0;
+	FILE* out = NULL;
+	char* tmp = NULL;
+
+	/* Place every record, the program's first. */
+	const size_t total = n + (program ? 1 : 0);
+	struct placement* placements = malloc((total + 1) * sizeof(*placements));
+	if (!placements) goto Write_Return;
+
+	size_t p = 0;
+	if (program) placements[p++].def = program;
+	for (size_t i = 0; i < n; ++i) placements[p++].def = defs[i].def;
+
+	const uint64_t tableBase = sizeof(struct header);
+	const uint64_t symbolBase = tableBase + n * sizeof(struct entry);
+
+	/* Gather the symbols: calls to anything not being written. */
+	struct placement* sorted = malloc((total + 1) * sizeof(*sorted));
+	if (!sorted) goto Write_Return;
+	memcpy(sorted, placements, total * sizeof(*sorted));
+	qsort(sorted, total, sizeof(*sorted), ComparePlacements);
+	for (size_t i = 0; i < total; ++i)
+		for (unsigned long j = 0; j < placements[i].def->length; ++j) {
+			const Instruction* in = &placements[i].def->code[j];
+			if (I_CALL != in->type) continue;
+			if (F_COMPILED == in->data.word.type) {
+				struct placement key = {in->data.word.data.compiled, 0};
+				if (bsearch(&key, sorted, total, sizeof(key),
+				            ComparePlacements)) continue; }
+			if (SymbolOf(&symbols, in->data.word) < 0) {
+				free(sorted);
+				goto Write_Return; }}
+	free(sorted);
+	const size_t nSymbols = symbols.n / sizeof(ForthWord);
+	if (nSymbols && !Named(state, &named, &nNamed))
+		goto Write_Return;
+
+	uint64_t recordBase = ALIGN(symbolBase + nSymbols * sizeof(struct symbol));
+	uint64_t offset = recordBase;
+	for (size_t i = 0; i < total; ++i) {
+		placements[i].record = offset;
+		offset += RecordSize(placements[i].def->length); }
+	const uint64_t stringBase = offset;
+
+	/* Header and tables. */
+	struct header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, IMAGE_MAGIC, sizeof(h.magic));
+	h.version          = IMAGE_VERSION;
+	h.instruction_size = sizeof(Instruction);
+	h.hash             = hash;
+	h.program          = program ? placements[0].record : 0;
+	h.definitions      = tableBase;
+	h.n_definitions    = n;
+	h.symbols          = symbolBase;
+	h.n_symbols        = nSymbols;
+	if (!Append(&records, &h, sizeof(h))) goto Write_Return;
+
+	for (size_t i = 0; i < n; ++i) {
+		struct entry e = {placements[i + (program ? 1 : 0)].record, 0};
+		if (defs[i].name &&
+		    !(e.name = StringOf(&strings, stringBase, defs[i].name)))
+			goto Write_Return;
+		if (!Append(&records, &e, sizeof(e))) goto Write_Return; }
+	for (size_t i = 0; i < nSymbols; ++i) {
+		const ForthWord word = ((const ForthWord*)symbols.bytes)[i];
+		const char* name = SymbolName(word, named, nNamed);
+		if (!name) {
+			/* A shadowed word, or a builtin not in the builtin table. */
+			DEBUG_PRINT("ImageWrite: Call to a word without a name.\n");
+			goto Write_Return; }
+		struct symbol sym = {StringOf(&strings, stringBase, name),
+		                     F_BUILTIN == word.type ? S_BUILTIN : S_WORD};
+		if (!sym.name || !Append(&records, &sym, sizeof(sym)))
+			goto Write_Return; }
+	static const char padding[8];
+	if (!Append(&records, padding, recordBase - records.n))
+		goto Write_Return;
+
+	/* Records, in placement order; callees are looked up by address. */
+	qsort(placements, total, sizeof(*placements), ComparePlacements);
+	for (size_t i = 0; i < total; ++i) {
+		const struct Definition* def = (program && !i) ? program
+			: defs[i - (program ? 1 : 0)].def;
+		if (!WriteRecord(&records, &strings, stringBase, def,
+		                 placements, total, &symbols))
+			goto Write_Return; }
+	iassert(records.n == stringBase);
+
+	/* The data space goes last, aligned, as its cells may be. */
+	const size_t nData = data ? DataHere(data) - DATA_START : 0;
+	if (nData) {
+		if (!Append(&strings, padding, ALIGN(stringBase + strings.n)
+		                               - (stringBase + strings.n)))
+			goto Write_Return;
+		((struct header*)records.bytes)->data   = stringBase + strings.n;
+		((struct header*)records.bytes)->n_data = nData;
+		if (!Append(&strings, DataAt(data, DATA_START, nData), nData))
+			goto Write_Return; }
+
+	/* Patch the final size in, and write it out. */
+	((struct header*)records.bytes)->size = records.n + strings.n;
+
+	/* The temporary's name is unique to this writer, as there may be others
+	   in this very process. */
+	if (!(tmp = malloc(strlen(path) + sizeof(".XXXXXX"))))
+		goto Write_Return;
+	sprintf(tmp, "%s.XXXXXX", path);
+	const int fd = mkstemp(tmp);
+	if (fd < 0) goto Write_Return;
+	fchmod(fd, 0644);
+	if (!(out = fdopen(fd, "wb"))) {
+		close(fd);
+		goto Write_Remove; }
+	if (fwrite(records.bytes, 1, records.n, out) != records.n ||
+	    (strings.n && fwrite(strings.bytes, 1, strings.n, out) != strings.n)) {
+		fclose(out);
+		goto Write_Remove; }
+	if (fclose(out)) goto Write_Remove;
+	if (rename(tmp, path)) goto Write_Remove;
+	ok = true;
+	goto Write_Return;
+
+	/* ERROR BLOCK */
+Write_Remove:
+	remove(tmp);
+Write_Return:
+	free(tmp);
+	free(named);
+	free(placements);
+	free(records.bytes);
+	free(strings.bytes);
+	free(symbols.bytes);
+	return ok;
+}
+
+/********** PUBLIC **********/
+uint64_t ImageHash(const void* bytes, size_t n)
+{
+	/* FNV-1a */
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	const unsigned char* b = bytes;
+	while (n--) {
+		hash ^= *b++;
+		hash *= 0x100000001b3ULL; }
+	return hash;
+}
+
+
+_Bool ImageWrite(const char* path, uint64_t hash, const struct State* state,
+                 const struct Definition* program,
+                 const struct NamedDefinition* defs, size_t n)
+{
+	cassert(path);
+	cassert(defs || !n);
+	return Write(path, hash, state, program, defs, n, NULL);
+}
+
+_Bool ImageSave(const char* path, struct State state)
+{
+	cassert(path);
+	cassert(state.namespace);
+
+	struct NamedDefinition* visible;
+	size_t nVisible;
+	if (!Named(&state, &visible, &nVisible)) return false;
+
+	/* Shadowed definitions still called are saved nameless, after the
+	   visible ones. The buffer doubles as the worklist. */
+	struct buffer b = {(char*)visible, nVisible * sizeof(*visible),
+	                                   nVisible * sizeof(*visible)};
+	for (size_t i = 0; i < b.n / sizeof(struct NamedDefinition); ++i) {
+		const struct Definition* def =
+			((struct NamedDefinition*)b.bytes)[i].def;
+		for (unsigned long j = 0; j < def->length; ++j) {
+			const Instruction* in = &def->code[j];
+			if (I_CALL != in->type || F_COMPILED != in->data.word.type)
+				continue;
+			struct NamedDefinition nd = {NULL, in->data.word.data.compiled};
+			const struct NamedDefinition* all = (void*)b.bytes;
+			if (bsearch(&nd, all, nVisible, sizeof(nd), CompareNamed))
+				continue;
+			size_t k = nVisible;
+			while (k < b.n / sizeof(nd) && all[k].def != nd.def) ++k;
+			if (k < b.n / sizeof(nd)) continue;
+			if (!Append(&b, &nd, sizeof(nd))) {
+				free(b.bytes);
+				return false; }}}
+
+	_Bool ok = Write(path, 0, NULL, NULL, (void*)b.bytes,
+	                 b.n / sizeof(struct NamedDefinition), state.data);
+	free(b.bytes);
+	return ok;
+}
+
+_Bool ImageOpen(const char* path, uint64_t hash, struct State state,
+                struct ImageMap* map, struct Definition** program)
+{
+	cassert(path);
+	cassert(state.namespace);
+	cassert(map);
+	cassert(program);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct header)) {
+		close(fd);
+		return false; }
+	const size_t size = (size_t)st.st_size;
+	/* Private and writable: relocation only copies the pages it touches. */
+	char* base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == base) return false;
+
+	ForthWord* symbols = NULL;
+	uint64_t*  records = NULL;
+	uint64_t   held    = 0; /* Leading symbols retained so far. */
+	const struct header* h = (const struct header*)base;
+	if (memcmp(h->magic, IMAGE_MAGIC, sizeof(h->magic)) ||
+	    IMAGE_VERSION != h->version ||
+	    sizeof(Instruction) != h->instruction_size ||
+	    hash != h->hash || size != h->size)
+		goto ImageOpen_Fail;
+	if (h->definitions > size || h->symbols > size ||
+	    h->n_definitions > (size - h->definitions) / sizeof(struct entry) ||
+	    h->n_symbols > (size - h->symbols) / sizeof(struct symbol))
+		goto ImageOpen_Fail;
+	/* Data can only go where nothing has been allotted yet. */
+	if (h->n_data && (h->data > size || h->n_data > size - h->data ||
+	                  !state.data || DATA_START != DataHere(state.data)))
+		goto ImageOpen_Fail;
+	const struct entry*  table = (const struct entry*)(base + h->definitions);
+	const struct symbol* syms  = (const struct symbol*)(base + h->symbols);
+
+	/* Resolve symbols by name, once each. Words called by the image are
+	   held onto, lest a redefinition free them from under it. */
+	symbols = malloc((h->n_symbols + 1) * sizeof(*symbols));
+	if (!symbols) goto ImageOpen_Fail;
+	for (; held < h->n_symbols; ++held) {
+		const char* name = StringAt(base, size, syms[held].name);
+		if (!name) goto ImageOpen_Fail;
+		ForthWord* w = &symbols[held];
+		w->type = F_BUILTIN;
+		if (S_BUILTIN == syms[held].kind)
+			w->data.builtin = BuiltinNamed(name);
+		else if (!(S_WORD == syms[held].kind &&
+		           Lookup(state, name, w)))
+			w->data.builtin = NULL;
+		if (F_BUILTIN == w->type && !w->data.builtin) {
+			DEBUG_PRINTF("ImageOpen: Nothing named `%s`.\n", name);
+			goto ImageOpen_Fail; }
+		if (F_COMPILED == w->type) DefinitionRetain(w->data.compiled); }
+
+	/* Every record must be relocated exactly once. */
+	const size_t nRecords = h->n_definitions + (h->program ? 1 : 0);
+	records = malloc((nRecords + 1) * sizeof(*records));
+	if (!records) goto ImageOpen_Fail;
+	for (uint64_t i = 0; i < h->n_definitions; ++i)
+		records[i] = table[i].record;
+	if (h->program) records[nRecords - 1] = h->program;
+	qsort(records, nRecords, sizeof(*records), CompareOffsets);
+	for (size_t i = 0; i < nRecords; ++i) {
+		struct Definition* def = RecordAt(base, size, records[i]);
+		if (!def || (i && records[i] == records[i-1]) ||
+		    !Relocate(base, size, def, records, nRecords,
+		              symbols, h->n_symbols))
+			goto ImageOpen_Fail; }
+
+	/* Only now is the image known to be sound: fill the data space, then
+	   define its words. */
+	if (h->n_data && !DataAppend(state.data, base + h->data, h->n_data))
+		goto ImageOpen_Fail;
+	for (uint64_t i = 0; i < h->n_definitions; ++i) {
+		if (!table[i].name) continue;
+		const char* name = StringAt(base, size, table[i].name);
+		char* key = name ? pstrdup(name) : NULL;
+		if (!key) continue;
+		ForthWord fw = {.data.compiled = (struct Definition*)(base + table[i].record),
+		                .type = F_COMPILED};
+		if (!DictReplace(state.namespace, &key, &fw)) free(key); }
+
+	*program = h->program ? (struct Definition*)(base + h->program) : NULL;
+	map->base     = base;
+	map->size     = size;
+	map->symbols  = symbols;
+	map->nSymbols = h->n_symbols;
+	free(records);
+	return true;
+
+	/* ERROR BLOCK */
+ImageOpen_Fail:
+	DEBUG_PRINTF("ImageOpen: Rejected `%s`.\n", path);
+	while (held--)
+		if (F_COMPILED == symbols[held].type)
+			DefinitionRelease(symbols[held].data.compiled);
+	free(symbols);
+	free(records);
+	munmap(base, size);
+	return false;
+}
+
+void ImageClose(struct ImageMap* map)
+{
+	cassert(map);
+	for (size_t i = 0; i < map->nSymbols; ++i)
+		if (F_COMPILED == map->symbols[i].type)
+			DefinitionRelease(map->symbols[i].data.compiled);
+	free(map->symbols);
+	if (map->base) munmap(map->base, map->size);
+	map->base     = NULL;
+	map->size     = 0;
+	map->symbols  = NULL;
+	map->nSymbols = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ForthTypes.h"
+#include "Definition.h"
+
+/* An image file mapped into memory by ImageOpen. */
+struct ImageMap {
+	void*  base;
+	size_t size;
+
+	/// Words called by the image but defined outside of it.
+	ForthWord* symbols;
+	size_t    nSymbols;
+};
+
+/* Hashes source text, so that images compiled from it can be keyed by it. */
+uint64_t ImageHash(const void* bytes, size_t n);
+
+/* Writes `program` (which can be NULL) and the `n` definitions of `defs`
+   to the image file at `path`, replacing it atomically. */
+/* Code may call builtins, the definitions being written, and words that
+   `state` (which can be NULL) can look up; the latter are looked up by name
+   again when the image is opened. */
+/* Returns false if the image could not be written. */
+_Bool ImageWrite(const char* path, uint64_t hash, const struct State* state,
+                 const struct Definition* program,
+                 const struct NamedDefinition* defs, size_t n);
+
+/* Writes every compiled word visible to `state`, and any shadowed
+   definitions they still call, to the image file at `path`, with a hash
+   of 0, along with all `state.data` (which can be NULL) has allotted. */
+/* Returns false if the image could not be written. */
+_Bool ImageSave(const char* path, struct State state);
+
+/* Maps the image at `path` copy-on-write, provided it was written with
+   `hash`, relocates its code in place, and adds its named definitions
+   to `state.namespace`. The mapped definitions are DEFINITION_STATIC. */
+/* An image with a data space needs `state.data`, with nothing allotted yet,
+   to copy it into. */
+/* `*program` is set to the image's program, or to NULL if it has none. */
+/* Returns false, leaving `state` untouched, if the image is missing,
+   stale or malformed. */
+_Bool ImageOpen(const char* path, uint64_t hash, struct State state,
+                struct ImageMap* map, struct Definition** program);
+
+/* Unmaps an image, and lets go of the words it calls. */
+/* Nothing may still refer to its definitions. */
+void ImageClose(struct ImageMap* map);
+
+#endif /* IMAGE_H */
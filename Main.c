@@ -3,7 +3,47 @@
  *
  * It has a few builtin functions. Look in the 'Builtins.c' file.
  * A small demo program you can feed to its STDIN is in 'MyProgram.forth.'
- * It does not currently have the abiltiy to humor user-defined functions.
+ * Given a file instead, it compiles the file whole, and caches the result
+ *  next to it, so that later runs of the unchanged file skip parsing.
+ * `"path" SAVE-IMAGE` saves every definition made so far, and running with
+ *  `--image path` starts off with them, mapped rather than recompiled.
+ *
+ * `"word" SPAWN` starts a task running a word, with stacks of its own;
+ *  tasks take turns whenever PAUSE is called, see 'Task.h'. THREAD starts
+ *  one on a thread instead; either can be fed through channels (CHAN).
+ * `limit start PAR-DO ... PAR-LOOP +` is a loop whose indices are spread
+ *  over every core, and whose results are summed, see 'Parallel.h'.
+ * `--jobs n` runs any number of source files at once, on n threads, each
+ *  file in a session of its own; their output is still printed in order.
+ *
+ * `--serve path` serves a session like the interpreter's own to each client
+ *  that connects to the Unix socket at path, all from one thread.
+ *
+ * Numbers with a point or an exponent, such as `1.5` or `2e3`, go on a
+ *  floating-point stack of their own, which F+, F* and the like work on.
+ * Integers are read in BASE, which HEX and DECIMAL set, unless prefixed:
+ *  `$FF` or `0xFF` is hexadecimal, `#10` decimal, and `%101` binary. As a
+ *  file is compiled whole before it runs, only HEX and DECIMAL, written
+ *  outside of any definition, change how the rest of it is read: `n BASE !`,
+ *  or HEX run from within a word, only changes how what's read after the
+ *  file has run is, by EVALUATE or at the prompt. Prefixes read the same
+ *  either way.
+ * HERE, ALLOT and CREATE lay out memory in the data space, which
+ *  `--huge-pages` backs with huge pages where it can.
+ *
+ * `--budget n` stops any word, or whole file, from running more than n
+ *  instructions at once, counting those of whatever it EVALUATEs; a task
+ *  that does is made to take turns instead.
+ *
+ * Usage: main.out [--image <image>] [--budget <n>] [--huge-pages]
+ *                 [<source file>]
+ *        main.out [--image <image>] [--budget <n>] [--huge-pages]
+ *                 --jobs <n> <source file>...
+ *        main.out [--image <image>] [--budget <n>] [--huge-pages]
+ *                 --serve <socket>
+ * User-defined words are compiled by ':' ... ';', see 'Compile.c'; in them,
+ *  `{: a b -- c :}` takes a and b off the stack into locals, which read
+ *  themselves, and which `x TO a` sets.
  *
  * It has a somewhat novel hash table design, using a bitset to store metadata.
  * Further, one can swap the 'Dict.h' symlink for one to 'AssocDictAsDict.h'
@@ -25,58 +65,105 @@
 
 #include <stdio.h>
 #include <stdlib.h> // free
-#include <string.h> // strcmp
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h> // strcmp, strcpy
+#include <unistd.h> // isatty
 #include "Dict.h"
 #include "Stack.h"
 #include "ForthTypes.h"
 
 #include "Alloca.h"
+#include "Batch.h"
 #include "Builtins.h"
+#include "Channel.h"
+#include "Compile.h"
+#include "DataSpace.h"
+#include "Definition.h"
 #include "Eval.h"
+#include "Execute.h"
 #include "GetObj.h"
+#include "Image.h"
+#include "Output.h"
+#include "Server.h"
+#include "Session.h"
+#include "Task.h"
 #include "CleanLeaks.h"
 
-void cstrcfree(void* v);
-void ErrorHandler(struct error e);
+/// Status lines are only for interactive sessions.
+static _Bool G_Verbose;
+#define STATUS(line) do { if (G_Verbose) puts(line); } while (0)
 
-void cstrcfree(void* v)
-{
-	free(*(char**)v);
-}
+/// Suffix of the bytecode cache kept next to each source file.
+#define CACHE_SUFFIX ".fbc"
 
-void ErrorHandler(struct error e)
+/* Runs the source file at `path`: from its bytecode cache if the cache was
+   compiled from the file as it is now, otherwise by compiling the file and
+   refreshing its cache, which is mapped into `cache`.
+   Returns false if the file could not be read. */
+static _Bool RunFile(struct State state, const char* path,
+                     struct ImageMap* cache)
 {
-	switch(e.type) {
-	case E_UNTERMINATED_STRING:
-		fprintf(stderr, "SYNTAX ERROR: Unterminated string `%s`.\n",
-		        e.bad_string);
-		break;
-	case E_BADNUM:
-		fprintf(stderr, "SYNTAX ERROR: Bad numeric literal `%s`.\n",
-		        e.bad_string);
-		break;
-	case E_NOTINDICT:
-		if (e.bad_string)
-			fprintf(stderr, "ERROR: Failed lookup on `%s`.\n", e.bad_string);
-		else fprintf(stderr, "ERROR: Failed lookup.\n");
-		return;
-		break;
-	case E_LINETOOLONG:
-		if (e.bad_string)
-			fprintf(stderr, "ERROR: Token `%s` too long.\n", e.bad_string);
-		else fprintf(stderr, "ERROR: Token too long.\n");
-		break;
-	default:
-		fprintf(stderr,
-		        "Unhandled enum error_type instance or invalid value passed to "
-		        "ErrorHandler callback ostensibly by Eval: %d.\n", e.type);
-		break; }
-}
+	FILE* source = fopen(path, "r");
+	if (!source) {
+		fprintf(stderr, "FAIL: Could not open `%s`.\n", path);
+		return false; }
+
+	/// The cache is keyed by a hash of the text it was compiled from,
+	/// which, if there is no cache, is then compiled where it was read to.
+	char* text = NULL;
+	size_t n = 0, allocated = 0;
+	for (;;) {
+		/* Room is always left for a NUL. */
+		if (n + 1 >= allocated) {
+			char* ptr = realloc(text, allocated = allocated ? allocated*2 : 4096);
+			if (!ptr) {
+				fprintf(stderr, "FAIL: Out of memory reading `%s`.\n", path);
+				free(text);
+				fclose(source);
+				return false; }
+			text = ptr; }
+		size_t got = fread(text + n, 1, allocated - n - 1, source);
+		if (!got) break;
+		n += got; }
+	fclose(source);
+	text[n] = '\0';
+	const uint64_t hash = ImageHash(text, n);
+
+	char* cachePath = malloc(strlen(path) + sizeof(CACHE_SUFFIX));
+	if (!cachePath) {
+		free(text);
+		return false; }
+	strcpy(cachePath, path);
+	strcat(cachePath, CACHE_SUFFIX);
 
-/// Global state; Passed by reference to mutators explicitly.
-static Dict  G_NameSpace;
-static Stack G_ForthStack;
-static Stack G_TypeStack;
+	struct Definition* program;
+	if (ImageOpen(cachePath, hash, state, cache, &program)) {
+		if (program) Execute(state, program);
+	} else {
+		Stack defined; PALLOCA(defined, StackSize());
+		defined = StackNew(defined, sizeof(struct NamedDefinition),
+		                   NamedDefinitionFree);
+		_Bool clean;
+		void* reader; PALLOCA(reader, StringObjSize());
+		const Reader input = CreateStringObj(reader, text);
+		program = defined ? CompileProgram(state, input, ErrorHandler,
+		                                   defined, &clean)
+		                  : NULL;
+		DeleteStringObj(reader);
+		/* Programs with errors aren't cached, so the errors are seen again. */
+		if (program && clean)
+			ImageWrite(cachePath, hash, &state, program,
+			           StackPeek(defined), StackDepth(defined));
+		if (program) {
+			Execute(state, program);
+			DefinitionRelease(program); }
+		if (defined) StackDelete(defined); }
+
+	free(cachePath);
+	free(text);
+	return true;
+}
 
 #include "Strdup.h"
 #include <assert.h>
@@ -129,63 +216,187 @@ void test(void) {
 	HashDictDelete(hd);
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
+	const char* image  = NULL;
+	const char* source = NULL;
+	const char* serve  = NULL;
+	unsigned    jobs   = 0;    /* Not a batch, if 0. */
+	unsigned long budget = 0;  /* No limit, if 0. */
+	_Bool hugePages = false;
+	const char* const* batch = NULL;
+	size_t nBatch = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--image") && i + 1 < argc)
+			image = argv[++i];
+		else if (!strcmp(argv[i], "--budget") && i + 1 < argc &&
+		         (budget = strtoul(argv[i+1], NULL, 10)))
+			++i;
+		else if (!strcmp(argv[i], "--jobs") && i + 2 < argc && !source &&
+		         !serve &&
+		         (jobs = strtoul(argv[i+1], NULL, 10))) {
+			batch  = (const char* const*)argv + i + 2;
+			nBatch = argc - i - 2;
+			break; }
+		else if (!strcmp(argv[i], "--serve") && i + 1 < argc && !source)
+			serve = argv[++i];
+		else if (!strcmp(argv[i], "--huge-pages"))
+			hugePages = true;
+		else if (!source && !serve && '-' != argv[i][0])
+			source = argv[i];
+		else {
+			fprintf(stderr,
+			        "Usage: %s [--image <image>] [--budget <n>] [--huge-pages] "
+			        "[<source file>]\n"
+			        "       %s [--image <image>] [--budget <n>] [--huge-pages] "
+			        "--jobs <n> <source file>...\n"
+			        "       %s [--image <image>] [--budget <n>] [--huge-pages] "
+			        "--serve <socket>\n",
+			        argv[0], argv[0], argv[0]);
+			return 1; }}
+	G_Verbose = !source && !jobs && !serve && isatty(STDIN_FILENO);
+
+	/// Interpreter state; Passed by reference to mutators explicitly.
+	Dict  namespace;
+	Stack stack, types, returns, floats;
+	/// Images in use, if any; unmapped once nothing refers to them.
+	struct ImageMap imageMap = {0}; /* From --image.          */
+	struct ImageMap cacheMap = {0}; /* A source file's cache. */
+
 	/* BEGIN TEST */
 	#ifdef TEST
 	test();
 	#endif /* TEST */
 
 	/// Initialize the Namespace that is to contain defined functions.
-	PALLOCA(G_NameSpace, DictSize());
-	G_NameSpace = DictNew(G_NameSpace, 0, sizeof(char*), sizeof(ForthWord),
-	                      cstrcSimpleHash, cstrcEq, cstrcfree, NULL);
-	if (!G_NameSpace) {
+	PALLOCA(namespace, DictSize());
+	namespace = DictNew(namespace, 0, sizeof(char*), sizeof(ForthWord),
+	                    cstrcSimpleHash, cstrcEq, cstrcfree, ForthWordFree);
+	if (!namespace) {
 		fprintf(stderr, "FAIL: "
 		        "NameSpace object could not be successfully initialized.\n");
 		return 1;}
-	else puts("OK: NameSpace object successfully initialized.");
+	else STATUS("OK: NameSpace object successfully initialized.");
 
 	/// Initialize the global stack that is to be manipulated by builtins.
-	PALLOCA(G_ForthStack, StackSize());
-	G_ForthStack = StackNew(G_ForthStack, sizeof(ForthDatum), NULL);
-	if (!G_ForthStack) {
+	PALLOCA(stack, StackSize());
+	stack = StackNew(stack, sizeof(ForthDatum), NULL);
+	if (!stack) {
 		fprintf(stderr,
 		        "FAIL: Global stack could not be successfully initialized.\n");
 		return 1;}
-	else puts("OK: Global stack successfully initialized.");
+	else STATUS("OK: Global stack successfully initialized.");
 
 	/// Initialize global typestack.
-	PALLOCA(G_TypeStack, StackSize());
-	G_TypeStack = StackNew(G_TypeStack, sizeof(enum datum_type), NULL);
-	if (!G_TypeStack) {
+	PALLOCA(types, StackSize());
+	types = StackNew(types, sizeof(enum datum_type), NULL);
+	if (!types) {
 		fprintf(stderr,
 		        "FAIL: Type tracker could not be successfully initialized.\n");
 		return 1;}
-		else puts("OK: Type tracker successfully initialized.");
+		else STATUS("OK: Type tracker successfully initialized.");
+
+	/// Initialize the return stack used by compiled words.
+	PALLOCA(returns, StackSize());
+	returns = StackNew(returns, sizeof(ReturnDatum), NULL);
+	if (!returns) {
+		fprintf(stderr,
+		        "FAIL: Return stack could not be successfully initialized.\n");
+		return 1;}
+	else STATUS("OK: Return stack successfully initialized.");
+
+	/// Initialize the floating-point stack.
+	PALLOCA(floats, StackSize());
+	floats = StackNew(floats, sizeof(double), NULL);
+	if (!floats) {
+		fprintf(stderr, "FAIL: Floating-point stack could not be "
+		                "successfully initialized.\n");
+		return 1;}
+	else STATUS("OK: Floating-point stack successfully initialized.");
 
 	/// Import builtins into namespace.
-	if(!ImportBuiltins(G_NameSpace, (_Bool)G_TypeStack)) {
+	if(!ImportBuiltins(namespace)) {
 		fprintf(stderr,
 		        "FAIL: Builtin functions could not be imported.\n"
 		        "Likely cause: lack of memory.\n");
 		return 1; }
-	else puts("OK: Builtin functions imported to namespace successfully.");
+	else STATUS("OK: Builtin functions imported to namespace successfully.");
+
+	/// Tasks started with SPAWN.
+	Tasks tasks; PALLOCA(tasks, TasksSize());
+	tasks = TasksNew(tasks);
+
+	/// Channels made by CHAN, by handle.
+	Channels channels; PALLOCA(channels, ChannelsSize());
+	channels = ChannelsNew(channels);
+
+	/// What builtins print, on its way to stdout.
+	Output output; PALLOCA(output, OutputSize());
+	output = OutputNew(output, stdout, stderr);
+
+	/// The data space, HERE, and everything allotted.
+	DataSpace data; PALLOCA(data, DataSpaceSize());
+	if (!(data = DataSpaceNew(data, hugePages))) {
+		fprintf(stderr, "FAIL: Data space could not be reserved.\n");
+		return 1; }
+	else STATUS("OK: Data space successfully reserved.");
+
+	const struct State state = {namespace, stack, types, returns, NULL, output,
+	                            tasks, channels, budget, NULL, data, floats,
+	                            false};
+
+	/// Restore a saved dictionary.
+	if (image) {
+		struct Definition* program;
+		if (!ImageOpen(image, 0, state, &imageMap, &program)) {
+			fprintf(stderr, "FAIL: Could not load image `%s`.\n", image);
+			return 1; }
+		else STATUS("OK: Image loaded."); }
 
 	/// Successful initialization!
-	puts("Thus Spake the Interpreter, 'Go FORTH and love the stack.'");
+	STATUS("Thus Spake the Interpreter, 'Go FORTH and love the stack.'");
+
+	int status = 0;
 
 	/// Main loop
-	while(Eval((struct State){G_NameSpace, G_ForthStack, G_TypeStack},
-			   CreateGetObj(stdin), ErrorHandler));
+	if (jobs || serve) {
+		/* Every session starts off with what has been loaded so far. */
+		Snapshot snap = SnapshotTake(state);
+		if (!snap) {
+			fprintf(stderr, "FAIL: Could not snapshot the interpreter.\n");
+			status = 1; }
+		else {
+			status = jobs ? !RunBatch(snap, batch, nBatch, jobs, RunFile, stdout)
+			              : !Serve(serve, snap, ErrorHandler);
+			SnapshotRelease(snap); }}
+	else if (source)
+		status = !RunFile(state, source, &cacheMap);
+	else {
+		void* reader; PALLOCA(reader, GetObjSize());
+		const Reader input = CreateGetObj(reader, stdin);
+		/* At a terminal, what was printed is seen before more is read. */
+		const _Bool interactive = isatty(STDIN_FILENO);
+		while(Eval(state, input, ErrorHandler))
+			if (interactive) OutputFlush(output);
+		DeleteGetObj(reader); }
+	/* Tasks still running at the end of the input are seen through. */
+	TasksRun(tasks);
+	OutputDelete(output);
 
 	/// Clean up.
 	//  Free leftover items on the global stack.
-	if (G_TypeStack)
-		CleanLeaks(G_ForthStack, G_TypeStack, stderr);
+	if (types)
+		CleanLeaks(stack, types, stderr);
 
-	if (G_TypeStack) StackDelete(G_TypeStack);
-	StackDelete(G_ForthStack);
-	DictDelete(G_NameSpace);
-	return 0;
+	TasksDelete(tasks);
+	ChannelsDelete(channels);
+	if (types) StackDelete(types);
+	StackDelete(floats);
+	StackDelete(returns);
+	StackDelete(stack);
+	DictDelete(namespace);
+	DataSpaceDelete(data);
+	ImageClose(&cacheMap);
+	ImageClose(&imageMap);
+	return status;
 }
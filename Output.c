@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h> // memcpy, strlen
+#include <stdbool.h>
+
+#include "Output.h"
+#include "Assert.h"
+
+/* Output is handed on once this much has gathered. */
+#define OUTPUT_BUFFER 8192
+
+struct Output {
+	FILE* sink;
+	FILE* errors;
+	size_t n;
+	char buf[OUTPUT_BUFFER];
+};
+
+/* The decimal digits of 0 to 99, two by two. */
+static const char Digits[] =
+	"00010203040506070809" "10111213141516171819"
+	"20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859"
+	"60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899";
+
+size_t OutputSize(void)
+{
+	return sizeof(struct Output);
+}
+
+Output OutputNew(void* memory, FILE* sink, FILE* errors)
+{
+	cassert(memory);
+	cassert(sink);
+	cassert(errors);
+
+	Output o = memory;
+	o->sink   = sink;
+	o->errors = errors;
+	o->n      = 0;
+	return o;
+}
+
+FILE* OutputSink(const Output o)
+{
+	cassert(o);
+	return o->sink;
+}
+
+FILE* OutputErrors(const Output o)
+{
+	cassert(o);
+	return o->errors;
+}
+
+void OutputWrite(Output o, const char* bytes, size_t n)
+{
+	cassert(o);
+	if (n > OUTPUT_BUFFER - o->n) {
+		fwrite(o->buf, 1, o->n, o->sink);
+		o->n = 0;
+		/* Too large to be worth copying. */
+		if (n > OUTPUT_BUFFER) {
+			fwrite(bytes, 1, n, o->sink);
+			return; }}
+	memcpy(o->buf + o->n, bytes, n);
+	o->n += n;
+}
+
+void OutputString(Output o, const char* s)
+{
+	cassert(s);
+	OutputWrite(o, s, strlen(s));
+}
+
+void OutputChar(Output o, char c)
+{
+	cassert(o);
+	if (OUTPUT_BUFFER == o->n) {
+		fwrite(o->buf, 1, o->n, o->sink);
+		o->n = 0; }
+	o->buf[o->n++] = c;
+}
+
+void OutputInt(Output o, long n)
+{
+	/* Written backwards, two digits at a time. */
+	char text[3 * sizeof(long) + 2];
+	char* p = text + sizeof(text);
+	unsigned long u = n < 0 ? -(unsigned long)n : (unsigned long)n;
+	while (u >= 100) {
+		const unsigned i = (unsigned)(u % 100) * 2;
+		u /= 100;
+		*--p = Digits[i + 1];
+		*--p = Digits[i]; }
+	if (u >= 10) {
+		*--p = Digits[u * 2 + 1];
+		*--p = Digits[u * 2]; }
+	else *--p = (char)('0' + u);
+	if (n < 0) *--p = '-';
+	OutputWrite(o, p, (size_t)(text + sizeof(text) - p));
+}
+
+void OutputFloat(Output o, double f)
+{
+	/* Enough digits to tell most apart, not so many that 0.1 + 0.2 shows
+	   its rounding. */
+	char text[32];
+	const int n = snprintf(text, sizeof(text), "%.15g", f);
+	OutputWrite(o, text, n > 0 ? (size_t)n : 0);
+}
+
+void OutputError(Output o, const char* format, ...)
+{
+	cassert(o);
+	cassert(format);
+	va_list args, again;
+	va_start(args, format);
+	va_copy(again, args);
+	char text[256];
+	int n;
+	if (o->errors != o->sink) vfprintf(o->errors, format, args);
+	else if ((n = vsnprintf(text, sizeof(text), format, args)) < 0) {}
+	else if ((size_t)n < sizeof(text)) OutputWrite(o, text, (size_t)n);
+	else {
+		/* Too long for `text`: what was gathered goes first. */
+		fwrite(o->buf, 1, o->n, o->sink);
+		o->n = 0;
+		vfprintf(o->sink, format, again); }
+	va_end(again);
+	va_end(args);
+}
+
+void OutputFlush(Output o)
+{
+	cassert(o);
+	if (o->n) fwrite(o->buf, 1, o->n, o->sink);
+	o->n = 0;
+	fflush(o->sink);
+}
+
+void OutputDelete(Output o)
+{
+	OutputFlush(o);
+}
@@ -0,0 +1,42 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+#include <stddef.h>
+#include <stdio.h>
+
+/* What builtins print is gathered here, and only handed to a FILE* when
+   there is a buffer's worth of it, or when flushed; so printing a token
+   costs a copy, rather than a locked stdio call that parses a format. */
+/* An Output belongs to one thread at a time. Threads that print to the
+   same FILE* each have an Output of their own over it. */
+typedef struct Output* Output;
+
+size_t OutputSize(void);
+
+/* Takes OutputSize() bytes of memory, the stream it fills, and the one
+   errors go to: stderr, or `sink` itself, as for a session served to a
+   client, who has to see the errors its input causes. */
+Output OutputNew(void* memory, FILE* sink, FILE* errors);
+
+FILE* OutputSink(const Output o);
+FILE* OutputErrors(const Output o);
+
+void OutputWrite(Output o, const char* bytes, size_t n);
+void OutputString(Output o, const char* s);
+void OutputChar(Output o, char c);
+/* Writes `n` in decimal. */
+void OutputInt(Output o, long n);
+/* Writes `f` to 15 significant digits, in exponent form if need be. */
+void OutputFloat(Output o, double f);
+
+/* Reports an error, formatted as by printf. Errors that go to the sink
+   are gathered along with the output, so stay in order with it. */
+void OutputError(Output o, const char* format, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/* Hands what has been gathered to the FILE*, and flushes that too. */
+void OutputFlush(Output o);
+
+/* Flushes, then lets go of the FILE*, which is left open. */
+void OutputDelete(Output o);
+
+#endif /* OUTPUT_H */
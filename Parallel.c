@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h> // malloc, free
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h> // sysconf
+
+#include "Parallel.h"
+#include "Stack.h"
+#include "Assert.h"
+#include "ForthTypes.h"
+#include "Execute.h"
+#include "Output.h"
+#include "Task.h"
+#include "Channel.h"
+
+/* Fewer indices than this aren't worth starting a thread for. */
+#define MIN_CHUNK 256
+#define MAX_WORKERS 64
+
+struct Worker {
+	pthread_t id;
+	struct State state;      /* Stacks and output of its own, no tasks. */
+	const Instruction* body;
+	ForthWord combine;
+	long limit;
+	long from, to;           /* The indices it runs, `to` excluded. */
+	struct Fuel fuel;        /* Its share of the caller's budget. */
+	_Bool started;
+};
+
+/* Set on workers' threads, where a PAR-DO doesn't start any more. */
+static _Thread_local _Bool InWorker;
+
+/********** PRIVATE **********/
+static inline _Bool Pop(struct State s, ForthDatum* d)
+{
+	if (s.types && !StackPop(s.types, NULL))
+		return false;
+	return StackPop(s.stack, d);
+}
+
+static inline ReturnDatum* Top(Stack returns)
+{
+	return (ReturnDatum*)StackPeek(returns) + StackDepth(returns) - 1;
+}
+
+static void Combine(struct State s, ForthWord combine)
+{
+	if (F_BUILTIN == combine.type) combine.data.builtin(s);
+	else Execute(s, combine.data.compiled);
+}
+
+/* Runs the body for each of a worker's indices, reducing as it goes. */
+static void* Work(void* arg)
+{
+	struct Worker* w = arg;
+	const struct State s = w->state;
+	InWorker = true;
+
+	/* A loop frame for I, which each index is written into. */
+	if (!StackPush(s.returns, &(ReturnDatum){.Int = w->limit}) ||
+	    !StackPush(s.returns, &(ReturnDatum){.Int = w->from})) {
+		OutputError(s.output, "ERROR: Return stack overflow.\n");
+		return NULL; }
+	for (long i = w->from; i != w->to && !ExecuteExhausted(s); ++i) {
+		Top(s.returns)->Int = i;
+		ExecuteCode(s, w->body);
+		if (StackDepth(s.stack) > 1) Combine(s, w->combine); }
+	StackPop(s.returns, NULL);
+	StackPop(s.returns, NULL);
+	return NULL;
+}
+
+/* Runs a worker on a thread of its own. */
+static void* WorkThread(void* arg)
+{
+	struct Worker* w = arg;
+	Work(w);
+	ChannelsLeave(w->state.channels);
+	return NULL;
+}
+
+/* Gives `w` stacks, with a copy of `parent`'s return stack, for J,
+   and an Output over `parent`'s sink. */
+static _Bool Prepare(struct Worker* w, struct State parent)
+{
+	w->state         = parent;
+	w->state.tasks   = NULL;
+	w->started       = false;
+	void* output = NULL;
+	if (!NewStacks(&w->state, parent.types) ||
+	    !(output = malloc(OutputSize()))) goto Prepare_Fail;
+	const ReturnDatum* frames = StackPeek(parent.returns);
+	for (size_t i = 0; i < StackDepth(parent.returns); ++i)
+		if (!StackPush(w->state.returns, &frames[i])) goto Prepare_Fail;
+	w->state.output = OutputNew(output, OutputSink(parent.output),
+	                            OutputErrors(parent.output));
+	return true;
+
+	/* ERROR BLOCK */
+Prepare_Fail:
+	free(output);
+	FreeStacks(&w->state);
+	return false;
+}
+
+static void Dismiss(struct Worker* w)
+{
+	OutputDelete(w->state.output);
+	free(w->state.output);
+	FreeStacks(&w->state);
+}
+
+static size_t Workers(unsigned long indices)
+{
+	if (InWorker) return 1;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores < 1) cores = 1;
+	if (cores > MAX_WORKERS) cores = MAX_WORKERS;
+	const unsigned long chunks = indices / MIN_CHUNK + 1;
+	return chunks < (unsigned long)cores ? chunks : (size_t)cores;
+}
+
+/********** PUBLIC **********/
+const Instruction* ParallelDo(struct State state, const Instruction* ip)
+{
+	cassert(ip);
+	iassert(I_PARDO == ip->type);
+
+	const Instruction* next = ip + ip->data.offset;
+	ForthDatum start, limit;
+	if (!Pop(state, &start)) start.Int = 0;
+	if (!Pop(state, &limit)) limit.Int = 0;
+	if (limit.Int <= start.Int) return next;
+
+	const unsigned long indices =
+		(unsigned long)limit.Int - (unsigned long)start.Int;
+	struct Worker workers[MAX_WORKERS];
+	size_t n = Workers(indices);
+
+	/* Contiguous ranges, so that results combine in index order. */
+	long from = start.Int;
+	for (size_t k = 0; k < n; ++k) {
+		struct Worker* w = &workers[k];
+		if (!Prepare(w, state)) {
+			/* Make do with those there are. */
+			if (!(n = k)) {
+				OutputError(state.output,
+				            "ERROR: Out of memory starting PAR-DO.\n");
+				return next; }
+			workers[k-1].to = limit.Int;
+			break; }
+		w->body    = ip + 1;
+		w->combine = ip[ip->data.offset - 1].data.word;
+		w->limit   = limit.Int;
+		w->from    = from;
+		w->to      = from = (long)((unsigned long)w->from
+		                           + indices / n + (k < indices % n)); }
+
+	/* The budget left is split between the workers, each drawing on its
+	   share alone, so that they never contend for it. */
+	const unsigned long share = state.fuel->left / n;
+	for (size_t k = 0; k < n; ++k) {
+		workers[k].fuel = (struct Fuel){share, false};
+		workers[k].state.fuel = &workers[k].fuel; }
+
+	/* The first range is run here, as are any a thread couldn't start for. */
+	/* Each worker's output is handed on in turn, after what came before. */
+	OutputFlush(state.output);
+	for (size_t k = 1; k < n; ++k) {
+		ChannelsEnter(state.channels);
+		workers[k].started =
+			!pthread_create(&workers[k].id, NULL, WorkThread, &workers[k]);
+		if (!workers[k].started) ChannelsLeave(state.channels); }
+	const _Bool inWorker = InWorker;
+	Work(&workers[0]);
+	InWorker = inWorker;
+
+	_Bool combining = false; /* Whether a result is on top of the stack. */
+	unsigned long spent = 0;
+	_Bool exhausted = false;
+	for (size_t k = 0; k < n; ++k) {
+		struct Worker* w = &workers[k];
+		if (k && w->started) pthread_join(w->id, NULL);
+		else if (k) {
+			Work(w);
+			InWorker = inWorker; }
+		spent += share - w->fuel.left;
+		exhausted |= w->fuel.exhausted;
+		const size_t results = StackDepth(w->state.stack);
+		if (results && !MoveItems(&state, w->state, results))
+			OutputError(state.output, "ERROR: Out of memory ending PAR-DO.\n");
+		else if (results && combining) Combine(state, w->combine);
+		else if (results) combining = true;
+		Dismiss(w); }
+
+	/* What the workers spent is charged to the caller, which gives up on
+	   the whole loop if any of them ran out. */
+	state.fuel->left -= spent < state.fuel->left ? spent : state.fuel->left;
+	if (exhausted) {
+		state.fuel->left = 0;
+		state.fuel->exhausted = true; }
+	return next;
+}
@@ -0,0 +1,21 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "ForthTypes.h"
+
+/* Fork-join loops: `limit start PAR-DO ... PAR-LOOP word` runs its body once
+   for each index from start up to limit, like DO ... LOOP, but spreads the
+   indices over a thread per core. Each thread has a data stack of its own,
+   and reduces the results its body leaves with `word`, as `+` or `MAX`;
+   what the threads are left with is then reduced in turn, in index order,
+   onto the caller's stack. */
+/* The body should leave one item; an empty range leaves nothing. Like
+   THREAD's words, it must not change any words. */
+/* The budget left to the word running it is split between the threads, and
+   what they spend is charged back to it; once any thread runs out of its
+   share, the whole PAR-DO, and that word, are given up on. */
+
+/* Runs the I_PARDO at `ip`, returning where execution carries on. */
+const Instruction* ParallelDo(struct State state, const Instruction* ip);
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h> // malloc, realloc, free
+#include <string.h> // memchr, memmove, strlen, strcpy
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h> // close, read, unlink
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "Server.h"
+#include "Alloca.h"
+#include "Assert.h"
+#include "GetObj.h"
+#include "Output.h"
+#include "Session.h"
+
+#define MAX_EVENTS 64
+/// Bytes read from a client per turn, so that none can hog the loop.
+#define READ_SIZE  (64 * 1024)
+/// A client whose input won't make a line by this size is let go.
+#define MAX_INPUT  (1024 * 1024)
+
+#define ISSEP(c) ((c) == ' ' || (c) == '\t' || (c) == '\n')
+
+struct client {
+	int fd;
+	Session session;
+	FILE*  out;        /* The session's output, into `output`. */
+	char*  output;
+	size_t size, sent;
+
+	char*  input;      /* Received, but not yet evaluated. */
+	size_t length, allocated;
+	size_t scanned;    /* How much of `input` has been tokenized. */
+	size_t ready;      /* How much of it can be evaluated. */
+	_Bool  defining;   /* Whether a ':' was scanned without its ';'. */
+	_Bool  hungUp;
+
+	struct client* prev;
+	struct client* next;
+};
+
+struct server {
+	int listener, epoll;
+	Snapshot snap;
+	void (*handleError)(struct Output*, struct error);
+	struct client* clients;
+};
+
+static volatile sig_atomic_t Stopping;
+
+/********** PRIVATE **********/
+static void Stop(int sig)
+{
+	(void)sig;
+	Stopping = 1;
+}
+
+static _Bool Watch(struct server* s, struct client* c, uint32_t events)
+{
+	struct epoll_event ev = {.events = events, .data.ptr = c};
+	return !epoll_ctl(s->epoll, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/* Tokenizes what arrived since the last call, as far as it can tell where
+   evaluation may stop: after a line, outside of any definition. */
+/* Suspends at a token the input ends in the middle of, to pick it up
+   again once more has arrived. */
+static void Scan(struct client* c)
+{
+	const char* in = c->input;
+	size_t i = c->scanned;
+	while (i < c->length) {
+		if (ISSEP(in[i])) {
+			if ('\n' == in[i] && !c->defining) c->ready = i + 1;
+			++i;
+			continue; }
+
+		size_t end = i;
+		if ('"' == in[i]) { /* Strings end with lines. */
+			while (++end < c->length && '"' != in[end] && '\n' != in[end]);
+			if (end == c->length) break;
+			if ('"' == in[end]) ++end;
+		} else {
+			while (end < c->length && !ISSEP(in[end])) ++end;
+			if (end == c->length) break;
+			if (1 == end - i && ':' == in[i]) c->defining = true;
+			if (1 == end - i && ';' == in[i]) c->defining = false; }
+		i = end; }
+	c->scanned = i;
+}
+
+/* Evaluates the input that is ready, keeping the rest for later. */
+static void Evaluate(struct server* s, struct client* c)
+{
+	if (!c->ready) return;
+
+	/* There is always room for a NUL past the input. */
+	const char saved = c->input[c->ready];
+	c->input[c->ready] = '\0';
+	void* reader; PALLOCA(reader, StringObjSize());
+	const Reader input = CreateStringObj(reader, c->input);
+	const struct State state = SessionState(c->session);
+	while (Eval(state, input, s->handleError));
+	DeleteStringObj(reader);
+	c->input[c->ready] = saved;
+
+	memmove(c->input, c->input + c->ready, c->length - c->ready);
+	c->length  -= c->ready;
+	c->scanned -= c->ready;
+	c->ready    = 0;
+}
+
+/* Sends what the session printed. Returns false if some is left to send
+   once the client is writable. */
+static _Bool Flush(struct client* c)
+{
+	OutputFlush(SessionState(c->session).output);
+	while (c->sent < c->size) {
+		const ssize_t n = send(c->fd, c->output + c->sent, c->size - c->sent,
+		                       MSG_NOSIGNAL);
+		if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) return false;
+		if (n < 0 && EINTR == errno) continue;
+		if (n < 0) {
+			/* Nobody is listening; the output is dropped. */
+			c->hungUp = true;
+			break; }
+		c->sent += (size_t)n; }
+	/* Start the buffer over. */
+	rewind(c->out);
+	fflush(c->out);
+	c->sent = 0;
+	return true;
+}
+
+/* Reads what the client sent, and scans it. */
+static void Receive(struct client* c)
+{
+	if (c->allocated - c->length < READ_SIZE + 1) {
+		const size_t allocated = c->length + READ_SIZE + 1;
+		char* input = realloc(c->input, allocated);
+		if (!input) {
+			OutputString(SessionState(c->session).output,
+			             "ERROR: Out of memory.\n");
+			c->hungUp = true;
+			return; }
+		c->input = input;
+		c->allocated = allocated; }
+
+	const ssize_t n = read(c->fd, c->input + c->length, READ_SIZE);
+	if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno))
+		return;
+	if (n <= 0) {
+		c->hungUp = true;
+		return; }
+	/* A NUL would end the text early, as Eval sees it. */
+	for (char* p = c->input + c->length; p < c->input + c->length + n; ++p)
+		if (!*p) *p = ' ';
+	c->length += (size_t)n;
+
+	Scan(c);
+	if (!c->ready && c->length > MAX_INPUT) {
+		OutputString(SessionState(c->session).output,
+		             "ERROR: Input too long.\n");
+		c->length = 0;
+		c->hungUp = true; }
+}
+
+static void Close(struct server* s, struct client* c)
+{
+	epoll_ctl(s->epoll, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	if (c->prev) c->prev->next = c->next;
+	else s->clients = c->next;
+	if (c->next) c->next->prev = c->prev;
+
+	SessionDelete(c->session);
+	free(c->session);
+	fclose(c->out);
+	free(c->output);
+	free(c->input);
+	free(c);
+}
+
+static void Accept(struct server* s)
+{
+	const int fd = accept(s->listener, NULL, NULL);
+	if (fd < 0) return;
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) || fcntl(fd, F_SETFD, FD_CLOEXEC))
+		goto Accept_Close;
+
+	struct client* c = calloc(1, sizeof(*c));
+	if (!c) goto Accept_Close;
+	c->fd = fd;
+	if (!(c->out = open_memstream(&c->output, &c->size)))
+		goto Accept_FreeClient;
+	/* Errors are the client's to see, along with the rest of its output. */
+	void* memory = malloc(SessionSize());
+	if (!memory ||
+	    !(c->session = SessionNew(memory, s->snap, c->out, c->out))) {
+		free(memory);
+		goto Accept_CloseOutput; }
+	/* A client mustn't be able to write files as the server's user. */
+	SessionConfine(c->session);
+
+	struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+	if (epoll_ctl(s->epoll, EPOLL_CTL_ADD, fd, &ev))
+		goto Accept_DeleteSession;
+	if ((c->next = s->clients)) c->next->prev = c;
+	s->clients = c;
+	return;
+
+	/* ERROR BLOCK */
+Accept_DeleteSession:
+	SessionDelete(c->session);
+	free(c->session);
+Accept_CloseOutput:
+	fclose(c->out);
+	free(c->output);
+Accept_FreeClient:
+	free(c);
+Accept_Close:
+	fprintf(stderr, "ERROR: Could not start a session.\n");
+	close(fd);
+}
+
+static void Handle(struct server* s, struct client* c, uint32_t events)
+{
+	if (c->sent < c->size) {
+		/* Only waiting to be able to send. */
+		if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) || !Flush(c)) return;
+	} else {
+		Receive(c);
+		/* Whatever is left is evaluated as it is, once nothing more can come. */
+		if (c->hungUp) c->ready = c->length;
+		Evaluate(s, c);
+		if (!Flush(c)) {
+			/* Stop reading until the client catches up. */
+			if (!Watch(s, c, EPOLLOUT)) Close(s, c);
+			return; }}
+
+	if (c->hungUp || !Watch(s, c, EPOLLIN)) Close(s, c);
+}
+
+/* Returns a socket listening at `path`, or -1. */
+static int Listen(const char* path)
+{
+	struct sockaddr_un address = {.sun_family = AF_UNIX};
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "FAIL: Socket path `%s` is too long.\n", path);
+		return -1; }
+	strcpy(address.sun_path, path);
+
+	/* A socket left behind by an earlier server is replaced. */
+	struct stat st;
+	if (!stat(path, &st) && S_ISSOCK(st.st_mode)) unlink(path);
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) goto Listen_Fail;
+	if (bind(fd, (struct sockaddr*)&address, sizeof(address)) ||
+	    listen(fd, SOMAXCONN)) {
+		close(fd);
+		goto Listen_Fail; }
+	return fd;
+
+	/* ERROR BLOCK */
+Listen_Fail:
+	fprintf(stderr, "FAIL: Could not listen at `%s`.\n", path);
+	return -1;
+}
+
+/********** PUBLIC **********/
+_Bool Serve(const char* path, Snapshot snap,
+            void(*handleError)(struct Output*, struct error))
+{
+	cassert(path);
+	cassert(snap);
+
+	struct server s = {.snap = snap, .handleError = handleError};
+	if ((s.listener = Listen(path)) < 0) return false;
+	if ((s.epoll = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		fprintf(stderr, "FAIL: Could not create an epoll instance.\n");
+		close(s.listener);
+		unlink(path);
+		return false; }
+	struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+	epoll_ctl(s.epoll, EPOLL_CTL_ADD, s.listener, &ev);
+
+	/* Without SA_RESTART, so that epoll_wait is interrupted. */
+	struct sigaction stop = {.sa_handler = Stop}, oldInt, oldTerm;
+	sigemptyset(&stop.sa_mask);
+	Stopping = 0;
+	sigaction(SIGINT, &stop, &oldInt);
+	sigaction(SIGTERM, &stop, &oldTerm);
+
+	struct epoll_event events[MAX_EVENTS];
+	while (!Stopping) {
+		const int n = epoll_wait(s.epoll, events, MAX_EVENTS, -1);
+		if (n < 0 && EINTR != errno) {
+			perror("ERROR: epoll_wait");
+			break; }
+		for (int i = 0; i < n; ++i)
+			if (!events[i].data.ptr) Accept(&s);
+			else Handle(&s, events[i].data.ptr, events[i].events); }
+
+	while (s.clients) Close(&s, s.clients);
+	sigaction(SIGINT, &oldInt, NULL);
+	sigaction(SIGTERM, &oldTerm, NULL);
+	close(s.epoll);
+	close(s.listener);
+	unlink(path);
+	return true;
+}
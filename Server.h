@@ -0,0 +1,20 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include "ForthTypes.h"
+#include "Eval.h"
+#include "Session.h"
+
+/* Serves interpreter sessions on the Unix domain socket at `path`: each
+   connection gets a session of its own, started from `snap`, which it
+   talks to as it would to the interpreter on a terminal. */
+/* A single thread serves every connection, through epoll: input is only
+   evaluated once a whole line of it, and any definition it opens, has
+   arrived, so that no session ever waits on its client. Errors, and what
+   `handleError` (which may be NULL) reports, are sent to the client along
+   with its output. Sessions can't write files: SAVE-IMAGE is refused. */
+/* Returns false if the socket could not be set up; otherwise serves
+   until interrupted. */
+_Bool Serve(const char* path, Snapshot snap,
+            void(*handleError)(struct Output*, struct error));
+
+#endif /* SERVER_H */
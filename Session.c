@@ -0,0 +1,287 @@
+#include <stdlib.h> // malloc, free
+#include <stdbool.h>
+#include <stddef.h> // max_align_t
+
+#include "Session.h"
+#include "Dict.h"
+#include "Stack.h"
+#include "ForthTypes.h"
+#include "ForthString.h"
+#include "ForthVector.h"
+#include "Definition.h"
+#include "Output.h"
+#include "DataSpace.h"
+#include "Channel.h"
+#include "CleanLeaks.h"
+#include "Strdup.h"
+#include "Assert.h"
+
+_Bool Lookup(struct State state, const char* word, ForthWord* fw)
+{
+	cassert(state.namespace);
+	cassert(word);
+	return DictGet(state.namespace, &word, fw)
+	    || (state.shared && DictGet(state.shared, &word, fw));
+}
+
+/* Namespaces that own their names and words, like the interpreter's own. */
+static Dict NamespaceNew(void* memory)
+{
+	return DictNew(memory, 0, sizeof(char*), sizeof(ForthWord),
+	               cstrcSimpleHash, cstrcEq, cstrcfree, ForthWordFree);
+}
+
+/* Copies the typed data stack `from` onto `to`, sharing its strings and
+   vectors. */
+static _Bool CopyStack(Stack to, Stack toTypes,
+                       const Stack from, const Stack fromTypes)
+{
+	const ForthDatum*      data  = StackPeek(from);
+	const enum datum_type* types = StackPeek(fromTypes);
+	for (size_t i = 0; i < StackDepth(from); ++i) {
+		ForthDatum d = data[i];
+		if (!StackPush(to, &d)) return false;
+		if (!StackPush(toTypes, &types[i])) {
+			StackPop(to, NULL);
+			return false; }
+		if (T_STRING == types[i]) StringRetain(d);
+		else if (T_VECTOR == types[i]) VectorRetain(d.Vector); }
+	return true;
+}
+
+/* Copies the floating-point stack `from` onto `to`. */
+static _Bool CopyFloats(Stack to, const Stack from)
+{
+	const double* floats = StackPeek(from);
+	for (size_t i = 0; i < StackDepth(from); ++i)
+		if (!StackPush(to, &floats[i])) return false;
+	return true;
+}
+
+/********** SNAPSHOTS **********/
+struct Snapshot {
+	_Atomic unsigned long refs; /* The taker, and each session. */
+	Dict  words;        /* Every word visible to the snapshotted state. */
+	Stack stack;
+	Stack types;        /* NULL if the snapshotted state was untyped. */
+	Stack floats;       /* NULL if the snapshotted state had none. */
+	DataSpace data;     /* NULL if the snapshotted state had none. */
+	unsigned long budget;
+};
+
+/* DictEach visitor copying words into a namespace, skipping shadowed ones. */
+struct flatten { Dict words; _Bool failed; };
+static void Flatten(const void* key, const void* val, void* ctx)
+{
+	struct flatten* f = ctx;
+	if (f->failed || DictHas(f->words, key)) return;
+	char* name = pstrdup(*(char* const*)key);
+	const ForthWord* fw = val;
+	if (!name || !DictAdd(f->words, &name, fw)) {
+		free(name);
+		f->failed = true;
+		return; }
+	if (F_COMPILED == fw->type)
+		DefinitionRetain(fw->data.compiled);
+}
+
+static void SnapshotFree(Snapshot snap)
+{
+	if (snap->words) DictDelete(snap->words);
+	if (snap->stack) {
+		if (snap->types) CleanLeaks(snap->stack, snap->types, NULL);
+		StackDelete(snap->stack); }
+	if (snap->types) StackDelete(snap->types);
+	if (snap->floats) StackDelete(snap->floats);
+	if (snap->data) DataSpaceDelete(snap->data);
+	free(snap->words);
+	free(snap->stack);
+	free(snap->types);
+	free(snap->floats);
+	free(snap->data);
+	free(snap);
+}
+
+Snapshot SnapshotTake(struct State state)
+{
+	cassert(state.namespace);
+	cassert(state.stack);
+	if (!state.types && !StackIsEmpty(state.stack)) return NULL;
+
+	Snapshot snap = calloc(1, sizeof(*snap));
+	if (!snap) return NULL;
+	snap->refs = 1;
+	snap->budget = state.budget;
+
+	/* The words are flattened into one namespace, so that sessions see
+	   at most two levels, however often they are snapshotted in turn. */
+	struct flatten f = {NULL, false};
+	void* memory;
+	if (!(memory = malloc(DictSize()))) goto SnapshotTake_Fail;
+	if (!(snap->words = f.words = NamespaceNew(memory))) {
+		free(memory);
+		goto SnapshotTake_Fail; }
+	DictEach(state.namespace, Flatten, &f);
+	if (state.shared) DictEach(state.shared, Flatten, &f);
+	if (f.failed) goto SnapshotTake_Fail;
+
+	if (!(memory = malloc(StackSize()))) goto SnapshotTake_Fail;
+	if (!(snap->stack = StackNew(memory, sizeof(ForthDatum), NULL))) {
+		free(memory);
+		goto SnapshotTake_Fail; }
+	if (state.types) {
+		if (!(memory = malloc(StackSize()))) goto SnapshotTake_Fail;
+		if (!(snap->types = StackNew(memory, sizeof(enum datum_type), NULL))) {
+			free(memory);
+			goto SnapshotTake_Fail; }
+		if (!CopyStack(snap->stack, snap->types, state.stack, state.types))
+			goto SnapshotTake_Fail; }
+	if (state.floats) {
+		if (!(memory = malloc(StackSize()))) goto SnapshotTake_Fail;
+		if (!(snap->floats = StackNew(memory, sizeof(double), NULL))) {
+			free(memory);
+			goto SnapshotTake_Fail; }
+		if (!CopyFloats(snap->floats, state.floats)) goto SnapshotTake_Fail; }
+	if (state.data) {
+		if (!(memory = malloc(DataSpaceSize()))) goto SnapshotTake_Fail;
+		if (!(snap->data = DataSpaceFreeze(memory, state.data))) {
+			free(memory);
+			goto SnapshotTake_Fail; }}
+	return snap;
+
+	/* ERROR BLOCK */
+SnapshotTake_Fail:
+	SnapshotFree(snap);
+	return NULL;
+}
+
+void SnapshotRelease(Snapshot snap)
+{
+	cassert(snap);
+	cassert(snap->refs);
+	if (!--snap->refs) SnapshotFree(snap);
+}
+
+/********** SESSIONS **********/
+struct Session {
+	Snapshot snapshot;
+	struct State state;
+
+	/* Memory for the namespace, stacks, data space, channels and output of
+	   `state`. */
+	void* parts;
+};
+
+size_t SessionSize(void)
+{
+	return sizeof(struct Session);
+}
+
+/* Rounds `n` up to a multiple of the strictest alignment. */
+static size_t Aligned(size_t n)
+{
+	const size_t a = _Alignof(max_align_t);
+	return (n + a - 1) / a * a;
+}
+
+Session SessionNew(void* memory, Snapshot snap, FILE* output, FILE* errors)
+{
+	cassert(memory);
+	cassert(snap);
+	cassert(output);
+	cassert(errors);
+	if (!memory) return NULL;
+
+	const size_t dictSize = Aligned(DictSize()), stackSize = Aligned(StackSize());
+	Session s = memory;
+	s->snapshot = snap;
+	s->state = (struct State){NULL, NULL, NULL, NULL, snap->words, NULL, NULL,
+	                          NULL, snap->budget, NULL, NULL, NULL, false};
+	if (!(s->parts = malloc(dictSize + 4*stackSize + Aligned(DataSpaceSize())
+	                        + Aligned(ChannelsSize()) + OutputSize())))
+		return NULL;
+
+	char* part = s->parts;
+	if (!(s->state.namespace = NamespaceNew(part)))
+		goto SessionNew_FreeParts;
+	part += dictSize;
+	if (!(s->state.stack = StackNew(part, sizeof(ForthDatum), NULL)))
+		goto SessionNew_DeleteNamespace;
+	part += stackSize;
+	if (!(s->state.returns = StackNew(part, sizeof(ReturnDatum), NULL)))
+		goto SessionNew_DeleteStack;
+	part += stackSize;
+	if (snap->types) {
+		if (!(s->state.types = StackNew(part, sizeof(enum datum_type), NULL)))
+			goto SessionNew_DeleteReturns;
+		if (!CopyStack(s->state.stack, s->state.types, snap->stack, snap->types))
+			goto SessionNew_DeleteTypes; }
+	part += stackSize;
+	if (snap->floats) {
+		if (!(s->state.floats = StackNew(part, sizeof(double), NULL)))
+			goto SessionNew_DeleteTypes;
+		if (!CopyFloats(s->state.floats, snap->floats))
+			goto SessionNew_DeleteFloats; }
+	part += stackSize;
+	if (snap->data && !(s->state.data = DataSpaceClone(part, snap->data)))
+		goto SessionNew_DeleteFloats;
+	part += Aligned(DataSpaceSize());
+	s->state.channels = ChannelsNew(part);
+	part += Aligned(ChannelsSize());
+	s->state.output = OutputNew(part, output, errors);
+
+	++snap->refs;
+	return s;
+
+	/* ERROR BLOCK */
+SessionNew_DeleteFloats:
+	if (s->state.floats) StackDelete(s->state.floats);
+SessionNew_DeleteTypes:
+	if (s->state.types) {
+		CleanLeaks(s->state.stack, s->state.types, NULL);
+		StackDelete(s->state.types); }
+SessionNew_DeleteReturns:
+	StackDelete(s->state.returns);
+SessionNew_DeleteStack:
+	StackDelete(s->state.stack);
+SessionNew_DeleteNamespace:
+	DictDelete(s->state.namespace);
+SessionNew_FreeParts:
+	free(s->parts);
+	return NULL;
+}
+
+struct State SessionState(const Session s)
+{
+	cassert(s);
+	return s->state;
+}
+
+void SessionSetBudget(Session s, unsigned long budget)
+{
+	cassert(s);
+	s->state.budget = budget;
+}
+
+void SessionConfine(Session s)
+{
+	cassert(s);
+	s->state.confined = true;
+}
+
+void SessionDelete(Session s)
+{
+	cassert(s);
+	OutputDelete(s->state.output);
+	ChannelsDelete(s->state.channels);
+	if (s->state.types) {
+		CleanLeaks(s->state.stack, s->state.types, NULL);
+		StackDelete(s->state.types); }
+	if (s->state.floats) StackDelete(s->state.floats);
+	StackDelete(s->state.returns);
+	StackDelete(s->state.stack);
+	DictDelete(s->state.namespace);
+	if (s->state.data) DataSpaceDelete(s->state.data);
+	free(s->parts);
+	SnapshotRelease(s->snapshot);
+}
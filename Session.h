@@ -0,0 +1,55 @@
+#ifndef SESSION_H
+#define SESSION_H
+#include <stddef.h>
+#include <stdio.h>
+#include "ForthTypes.h"
+
+/* Looks `word` up in `state.namespace`, then in the words beneath it,
+   `state.shared`. */
+/* `fw` can be NULL. Returns false if neither has the word. */
+_Bool Lookup(struct State state, const char* word, ForthWord* fw);
+
+/* A frozen copy of an interpreter's words, stacks and data space, which
+   any number of sessions can be started from. */
+typedef struct Snapshot* Snapshot;
+
+/* Snapshots `state`, which can go on to change without affecting it. */
+/* Compiled code isn't copied, only shared, as it never changes. */
+/* Returns NULL on failed allocation, or if `state` is untyped and its stack
+   isn't empty, since its strings couldn't be told apart to copy them. */
+Snapshot SnapshotTake(struct State state);
+
+/* Lets go of a snapshot, which is freed once its sessions are too. */
+void SnapshotRelease(Snapshot snap);
+
+/* An interpreter state started from a snapshot. The snapshot's words are
+   the session's `state.shared`: they are looked up in place, and words the
+   session defines go to its own namespace, shadowing them. */
+/* Only the snapshot's stacks and data space are copied, so starting one
+   costs next to nothing, however many words the snapshot has. Sessions of
+   a snapshot can run on different threads. */
+typedef struct Session* Session;
+
+size_t SessionSize(void);
+
+/* The session's builtins print to `output`, and report errors to `errors`,
+   through an Output of its own, which is flushed by SessionDelete; see
+   'Output.h'. */
+/* Returns NULL on failed allocation. */
+Session SessionNew(void* memory, Snapshot snap, FILE* output, FILE* errors);
+
+/* The state to evaluate the session's input with. */
+struct State SessionState(const Session s);
+
+/* Sets the instruction budget of the session's state, which starts off
+   as that of the snapshotted state. */
+void SessionSetBudget(Session s, unsigned long budget);
+
+/* Has the session refuse words that write files, such as SAVE-IMAGE, for
+   when its input comes from someone who shouldn't. */
+void SessionConfine(Session s);
+
+/* Frees whatever was left on the session's stacks, then the session. */
+void SessionDelete(Session s);
+
+#endif /* SESSION_H */
@@ -47,6 +47,9 @@ Stack StackNew(void* memory, size_t elemsize,
 _Bool StackIsEmpty(Stack s)
 { return 0 == s->n; }
 
+size_t StackDepth(const Stack s)
+{ return s->n; }
+
 _Bool StackPush(Stack s, const void* elem)
 {
 	assert(s); // STRICT
@@ -54,7 +57,7 @@ _Bool StackPush(Stack s, const void* elem)
 	if (!s) return false;
 
 	assert(s->n <= s->allocated); // STRICT
-	if (s->allocated >= s->n) {
+	if (s->n >= s->allocated) {
 		char* ptr = realloc(s->stackBuf, s->allocated * s->elemsize * 2);
 		if (!ptr) // Failed allocation, leave s's contents untouched.
 			return false;
@@ -8,6 +8,8 @@ Stack StackNew(void* memory, size_t elemsize,
                // elemfree can be NULL.
                void(*elemfree)(void*));
 _Bool StackIsEmpty(Stack s);
+/* Returns the number of elements on the stack. */
+size_t StackDepth(const Stack s);
 _Bool StackPush(Stack s, const void* elem);
 _Bool StackPop(Stack s,
                // elemSpace can be NULL.
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h> // malloc, free
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h> // sched_yield
+
+#include "Task.h"
+#include "Stack.h"
+#include "Assert.h"
+#include "ForthTypes.h"
+#include "Definition.h"
+#include "Execute.h"
+#include "Output.h"
+#include "Channel.h"
+#include "CleanLeaks.h"
+
+struct Task {
+	struct State state;    /* Its own stacks. */
+	const Instruction* ip; /* Where it resumes. */
+	struct Definition* def;
+	struct Task* next;     /* In the ready queue. */
+};
+
+/* Words run on threads of their own; see TaskThread. */
+struct Thread {
+	pthread_t id;
+	struct State state;
+	struct Definition* def;
+	struct Thread* next;
+};
+
+struct Tasks {
+	struct Task* head; /* The ready queue, runs from `head` to `tail`. */
+	struct Task* tail;
+	struct Task* current; /* NULL outside of a turn. */
+	_Bool pausing;
+	_Bool blocked;        /* Whether the pausing task is to retry its word. */
+
+	struct Thread* threads; /* Yet to be joined. */
+};
+
+/********** PUBLIC: STACKS **********/
+/* Gives `s` stacks of its own, typed if `typed`. Returns false on failed
+   allocation, leaving whichever stacks were made for FreeStacks. */
+_Bool NewStacks(struct State* s, _Bool typed)
+{
+	s->stack = s->types = s->returns = s->floats = NULL;
+	void* memory;
+	if (!(memory = malloc(StackSize()))) return false;
+	if (!(s->stack = StackNew(memory, sizeof(ForthDatum), NULL))) {
+		free(memory);
+		return false; }
+	if (!(memory = malloc(StackSize()))) return false;
+	if (!(s->returns = StackNew(memory, sizeof(ReturnDatum), NULL))) {
+		free(memory);
+		return false; }
+	if (!(memory = malloc(StackSize()))) return false;
+	if (!(s->floats = StackNew(memory, sizeof(double), NULL))) {
+		free(memory);
+		return false; }
+	if (!typed) return true;
+	if (!(memory = malloc(StackSize()))) return false;
+	if (!(s->types = StackNew(memory, sizeof(enum datum_type), NULL))) {
+		free(memory);
+		return false; }
+	return true;
+}
+
+/* Moves the top `n` items of `from`'s stack onto `to`'s, in order. */
+/* Returns false, moving none, if there are fewer or on failed allocation. */
+_Bool MoveItems(struct State* to, struct State from, size_t n)
+{
+	const size_t depth = StackDepth(from.stack);
+	if (depth < n) return false;
+	const ForthDatum* data = (ForthDatum*)StackPeek(from.stack) + depth - n;
+	const enum datum_type* types =
+		from.types ? (enum datum_type*)StackPeek(from.types) + depth - n : NULL;
+	for (size_t i = 0; i < n; ++i)
+		if (!StackPush(to->stack, &data[i]) ||
+		    (to->types && !StackPush(to->types, &types[i]))) {
+			/* The items still belong to `from`; forget the copies. */
+			while (StackPop(to->stack, NULL));
+			if (to->types) while (StackPop(to->types, NULL));
+			return false; }
+	for (size_t i = 0; i < n; ++i) {
+		StackPop(from.stack, NULL);
+		if (from.types) StackPop(from.types, NULL); }
+	return true;
+}
+
+/* Frees the stacks NewStacks made, and whatever was left on them. */
+void FreeStacks(struct State* s)
+{
+	if (s->types) {
+		CleanLeaks(s->stack, s->types, stderr);
+		StackDelete(s->types);
+		free(s->types); }
+	if (s->returns) {
+		StackDelete(s->returns);
+		free(s->returns); }
+	if (s->floats) {
+		StackDelete(s->floats);
+		free(s->floats); }
+	if (s->stack) {
+		StackDelete(s->stack);
+		free(s->stack); }
+}
+
+/********** PRIVATE **********/
+static void Enqueue(Tasks t, struct Task* task)
+{
+	task->next = NULL;
+	if (t->tail) t->tail->next = task;
+	else t->head = task;
+	t->tail = task;
+}
+
+static struct Task* Dequeue(Tasks t)
+{
+	struct Task* task = t->head;
+	if (task && !(t->head = task->next)) t->tail = NULL;
+	return task;
+}
+
+static void TaskFree(struct Task* task)
+{
+	FreeStacks(&task->state);
+	DefinitionRelease(task->def);
+	free(task);
+}
+
+/* Gives each task that is ready now a turn, leaving those it spawns for
+   the next round. */
+static void Round(Tasks t)
+{
+	const struct Task* last = t->tail;
+	_Bool more = last;
+	while (more) {
+		struct Task* task = Dequeue(t);
+		more = task != last;
+		t->current = task;
+		task->ip = Resume(task->state, task->ip);
+		t->current = NULL;
+		t->pausing = t->blocked = false;
+		if (task->ip) Enqueue(t, task);
+		else TaskFree(task); }
+}
+
+/********** PUBLIC **********/
+size_t TasksSize(void)
+{
+	return sizeof(struct Tasks);
+}
+
+Tasks TasksNew(void* memory)
+{
+	cassert(memory);
+	if (!memory) return NULL;
+
+	Tasks t = memory;
+	*t = (struct Tasks){NULL, NULL, NULL, false, false, NULL};
+	return t;
+}
+
+_Bool TaskSpawn(Tasks t, struct State parent, struct Definition* def,
+                size_t argc)
+{
+	cassert(t);
+	cassert(def);
+
+	struct Task* task = calloc(1, sizeof(*task));
+	if (!task) return false;
+	task->state = parent;
+	task->state.tasks = t;
+	task->state.fuel  = NULL; /* Each turn has a budget of its own. */
+	task->ip  = def->code;
+	task->def = def;
+	DefinitionRetain(def);
+	if (!NewStacks(&task->state, parent.types) ||
+	    !MoveItems(&task->state, parent, argc)) {
+		TaskFree(task);
+		return false; }
+
+	Enqueue(t, task);
+	return true;
+}
+
+static void* RunThread(void* vth)
+{
+	struct Thread* th = vth;
+	Execute(th->state, th->def);
+	OutputFlush(th->state.output);
+	ChannelsLeave(th->state.channels);
+	return NULL;
+}
+
+_Bool TaskThread(Tasks t, struct State parent, struct Definition* def,
+                 size_t argc)
+{
+	cassert(t);
+	cassert(def);
+
+	struct Thread* th = calloc(1, sizeof(*th));
+	if (!th) return false;
+	th->state = parent;
+	th->state.tasks = NULL;
+	th->state.fuel  = NULL;
+	th->def = def;
+	DefinitionRetain(def);
+	/* Printing through an Output of its own, after what was printed so far. */
+	OutputFlush(parent.output);
+	void* output = NULL;
+	if (!NewStacks(&th->state, parent.types) ||
+	    !(output = malloc(OutputSize())) ||
+	    !MoveItems(&th->state, parent, argc)) goto TaskThread_Fail;
+	th->state.output = OutputNew(output, OutputSink(parent.output),
+	                             OutputErrors(parent.output));
+	ChannelsEnter(parent.channels);
+	if (pthread_create(&th->id, NULL, RunThread, th)) {
+		ChannelsLeave(parent.channels);
+		goto TaskThread_Fail; }
+
+	th->next = t->threads;
+	t->threads = th;
+	return true;
+
+	/* ERROR BLOCK */
+TaskThread_Fail:
+	FreeStacks(&th->state);
+	DefinitionRelease(def);
+	free(output);
+	free(th);
+	return false;
+}
+
+void TasksPause(Tasks t)
+{
+	cassert(t);
+	if (t->current) t->pausing = true;
+	else Round(t);
+}
+
+_Bool TasksBlock(Tasks t)
+{
+	cassert(t);
+	if (t->current) return t->pausing = t->blocked = true;
+	Round(t);
+	return false;
+}
+
+_Bool TasksOthers(const Tasks t)
+{
+	return t && (t->current || t->head);
+}
+
+_Bool TasksPausing(const Tasks t)
+{
+	cassert(t);
+	return t->pausing;
+}
+
+_Bool TasksBlocked(const Tasks t)
+{
+	cassert(t);
+	return t->blocked;
+}
+
+void TasksRun(Tasks t)
+{
+	cassert(t);
+	while (t->head) {
+		Round(t);
+		/* Tasks may well be waiting on threads, which then need the time. */
+		if (t->threads) sched_yield(); }
+	/* Threads may still be waiting on tasks, so are joined only after. */
+	while (t->threads) {
+		struct Thread* th = t->threads;
+		t->threads = th->next;
+		pthread_join(th->id, NULL);
+		OutputDelete(th->state.output);
+		free(th->state.output);
+		FreeStacks(&th->state);
+		DefinitionRelease(th->def);
+		free(th); }
+}
+
+void TasksDelete(Tasks t)
+{
+	cassert(t);
+	struct Task* task;
+	while ((task = Dequeue(t))) TaskFree(task);
+	TasksRun(t);
+}
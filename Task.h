@@ -0,0 +1,71 @@
+#ifndef TASK_H
+#define TASK_H
+#include <stddef.h>
+#include "ForthTypes.h"
+
+/* Cooperative tasks: compiled words run with stacks of their own, which take
+   turns at running whenever PAUSE is called. */
+/* A task runs until it pauses, ends, or has taken the instruction budget
+   it inherits from its parent's state; the interpreter's own PAUSE gives
+   every ready task a turn, round-robin, before carrying on. Switching is
+   no more than resuming another task's instruction pointer with its own
+   stacks, and a task costs a few small allocations. */
+typedef struct Tasks* Tasks;
+
+size_t TasksSize(void);
+
+Tasks TasksNew(void* memory);
+
+/* Queues a task that runs `def`, sharing the words and output of `parent`,
+   but with stacks of its own, onto which the top `argc` items of the
+   parent's stack are moved. */
+/* Returns false, moving nothing, if the parent's stack has fewer items,
+   or on failed allocation. */
+_Bool TaskSpawn(Tasks t, struct State parent, struct Definition* def,
+                size_t argc);
+
+/* As TaskSpawn, but runs `def` at once on a thread of its own, where there
+   are no tasks. The thread must not change any words, as `parent` may
+   be reading them. Returns false if the thread could not be started. */
+_Bool TaskThread(Tasks t, struct State parent, struct Definition* def,
+                 size_t argc);
+
+/* What PAUSE does: from a task, ends its turn, once the builtin returns;
+   otherwise, gives each ready task a turn. */
+void TasksPause(Tasks t);
+
+/* What words that can't go on yet do: from a task, ends its turn, and has
+   the word run again on its next, returning true. Otherwise, gives each
+   ready task a turn, returning false, after which the word may try again. */
+_Bool TasksBlock(Tasks t);
+
+/* Returns true if another task of `t` (which can be NULL) could still run,
+   and so be at the other end of a channel: the running task's scheduler,
+   or a ready task. Threads are counted apart; see ChannelsShared. */
+_Bool TasksOthers(const Tasks t);
+
+/* Returns true if the running task is to be switched out. */
+_Bool TasksPausing(const Tasks t);
+
+/* Returns true if the running task is to run its last word again. */
+_Bool TasksBlocked(const Tasks t);
+
+/* Gives ready tasks turns until none are left, then waits for threads. */
+void TasksRun(Tasks t);
+
+/* Frees any tasks that didn't finish, once threads are done. */
+void TasksDelete(Tasks t);
+
+/* Stacks of a State of one's own, as tasks and PAR-DO workers have. */
+/* Gives `s` stacks of its own, typed if `typed`. Returns false on failed
+   allocation, leaving whichever stacks were made for FreeStacks. */
+_Bool NewStacks(struct State* s, _Bool typed);
+
+/* Moves the top `n` items of `from`'s stack onto `to`'s, in order. */
+/* Returns false, moving none, if there are fewer or on failed allocation. */
+_Bool MoveItems(struct State* to, struct State from, size_t n);
+
+/* Frees the stacks NewStacks made, and whatever was left on them. */
+void FreeStacks(struct State* s);
+
+#endif /* TASK_H */
@@ -4,5 +4,5 @@
 # This makes the default 'Dict.h' that every file imports, into the hashtable.
 ln -s HashDictAsDict.h Dict.h
 
-cc *.c        -o main.out # Just the interpreter.
-cc *.c -DTEST -o test.out # Runs a little test of the HT before running.
+cc *.c        -pthread -o main.out # Just the interpreter.
+cc *.c -DTEST -pthread -o test.out # Runs a little test of the HT before running.